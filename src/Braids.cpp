@@ -36,7 +36,8 @@ struct Braids : Module {
 	dsp::SampleRateConverter<1> src;
 	dsp::DoubleRingBuffer<dsp::Frame<1>, 256> outputBuffer;
 	bool lastTrig = false;
-	bool lowCpu = false;
+	QualityTierSetting qualityTier;
+	GovernorClient governorClient;
 
 	Braids() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS);
@@ -69,6 +70,10 @@ struct Braids : Module {
 	}
 
 	void process(const ProcessArgs& args) override {
+		DenormalGuard denormalGuard;
+		GovernorClient::Timer governorTimer(governorClient, args.sampleTime);
+		qualityTier.apply();
+
 		// Trigger
 		bool trig = inputs[TRIG_INPUT].getVoltage() >= 1.0;
 		if (!lastTrig && trig) {
@@ -78,6 +83,9 @@ struct Braids : Module {
 
 		// Render frames
 		if (outputBuffer.empty()) {
+			// Skip resampling in eco quality, or when the plugin is over its CPU budget
+			bool lowCpuActive = qualityTier.tier == QUALITY_ECO || governor.isReduced();
+
 			float fm = params[FM_PARAM].getValue() * inputs[FM_INPUT].getVoltage();
 
 			// Set shape
@@ -101,7 +109,7 @@ struct Braids : Module {
 			float pitchV = inputs[PITCH_INPUT].getVoltage() + params[COARSE_PARAM].getValue() + params[FINE_PARAM].getValue() / 12.0;
 			if (!settings.meta_modulation)
 				pitchV += fm;
-			if (lowCpu)
+			if (lowCpuActive)
 				pitchV += std::log2(96000.f * args.sampleTime);
 			int32_t pitch = (pitchV * 12.0 + 60) * 128;
 			pitch += jitter_source.Render(settings.vco_drift);
@@ -123,7 +131,7 @@ struct Braids : Module {
 				render_buffer[i] = stmlib::Mix(sample, warped, signature);
 			}
 
-			if (lowCpu) {
+			if (lowCpuActive) {
 				for (int i = 0; i < 24; i++) {
 					dsp::Frame<1> f;
 					f.samples[0] = render_buffer[i] / 32768.0;
@@ -137,6 +145,7 @@ struct Braids : Module {
 					in[i].samples[0] = render_buffer[i] / 32768.0;
 				}
 				src.setRates(96000, args.sampleRate);
+				src.setQuality(getSrcQuality(qualityTier.tier));
 
 				int inLen = 24;
 				int outLen = outputBuffer.capacity();
@@ -162,8 +171,9 @@ struct Braids : Module {
 		}
 		json_object_set_new(rootJ, "settings", settingsJ);
 
-		json_t* lowCpuJ = json_boolean(lowCpu);
-		json_object_set_new(rootJ, "lowCpu", lowCpuJ);
+		json_object_set_new(rootJ, "qualityTier", json_integer(qualityTier.requested));
+		// Read by versions without quality tiers
+		json_object_set_new(rootJ, "lowCpu", json_boolean(qualityTier.requested == QUALITY_ECO));
 
 		return rootJ;
 	}
@@ -179,10 +189,7 @@ struct Braids : Module {
 			}
 		}
 
-		json_t* lowCpuJ = json_object_get(rootJ, "lowCpu");
-		if (lowCpuJ) {
-			lowCpu = json_boolean_value(lowCpuJ);
-		}
+		qualityTierFromJson(rootJ, &qualityTier);
 	}
 
 	int getShapeParam() {
@@ -350,7 +357,8 @@ struct BraidsWidget : ModuleWidget {
 			[=](bool val) {module->settings.signature = val ? 4 : 0;}
 		));
 
-		menu->addChild(createBoolPtrMenuItem("Low CPU (disable resampling)", &module->lowCpu));
+		appendQualityMenu(menu, &module->qualityTier);
+		appendGovernorMenu(menu);
 	}
 };
 
@@ -32,6 +32,7 @@ struct Branches : Module {
 	dsp::BooleanTrigger modeTriggers[2];
 	bool modes[2] = {};
 	bool outcomes[2][16] = {};
+	RandomSource randomSource;
 
 	Branches() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -46,6 +47,8 @@ struct Branches : Module {
 	}
 
 	void process(const ProcessArgs& args) override {
+		randomSource.update();
+
 		for (int i = 0; i < 2; i++) {
 			// Get input
 			Input* input = &inputs[IN1_INPUT + i];
@@ -68,7 +71,7 @@ struct Branches : Module {
 					// trigger
 					// We don't have to clamp here because the threshold comparison works without it.
 					float threshold = params[THRESHOLD1_PARAM + i].getValue() + inputs[P1_INPUT + i].getPolyVoltage(c) / 10.f;
-					bool toss = (random::uniform() < threshold);
+					bool toss = (randomSource.prng.uniform() < threshold);
 					if (!modes[i]) {
 						// direct modes
 						outcomes[i][c] = toss;
@@ -118,6 +121,7 @@ struct Branches : Module {
 			json_array_insert_new(modesJ, i, json_boolean(modes[i]));
 		}
 		json_object_set_new(rootJ, "modes", modesJ);
+		randomSource.toJson(rootJ);
 		return rootJ;
 	}
 
@@ -130,6 +134,7 @@ struct Branches : Module {
 					modes[i] = json_boolean_value(modeJ);
 			}
 		}
+		randomSource.fromJson(rootJ);
 	}
 };
 
@@ -175,6 +180,9 @@ struct BranchesWidget : ModuleWidget {
 			"Latch",
 			"Toggle",
 		}, &module->modes[1]));
+
+		menu->addChild(new MenuSeparator);
+		appendRandomSourceMenu(menu, &module->randomSource);
 	}
 };
 
@@ -1,4 +1,7 @@
 #include "plugin.hpp"
+#include <thread>
+#include <atomic>
+#include <chrono>
 #include "clouds/dsp/granular_processor.h"
 
 
@@ -50,20 +53,84 @@ struct Clouds : Module {
 	dsp::SampleRateConverter<2> outputSrc;
 	dsp::DoubleRingBuffer<dsp::Frame<2>, 256> inputBuffer;
 	dsp::DoubleRingBuffer<dsp::Frame<2>, 256> outputBuffer;
+	/** Only picks the quality of inputSrc and outputSrc. The processor's buffer format is `quality`, which the tier never changes. */
+	QualityTierSetting qualityTier;
+	Recorder recorder;
 
+	Arena arena;
 	uint8_t* block_mem;
 	uint8_t* block_ccm;
 	clouds::GranularProcessor* processor;
 
 	bool triggered = false;
+	/** Freeze state of the last block, for the light */
+	bool frozen = false;
 
 	dsp::SchmittTrigger freezeTrigger;
 	bool freeze = false;
 	dsp::SchmittTrigger blendTrigger;
 	int blendMode = 0;
 
-	clouds::PlaybackMode playback;
+	/** Settings the processor is using. Only touched by the audio thread. */
+	clouds::PlaybackMode playback = clouds::PLAYBACK_MODE_GRANULAR;
 	int quality = 0;
+	/** The settings as last requested, which the menu and dataToJson() show before the audio thread applies them */
+	clouds::PlaybackMode requestedPlayback = clouds::PLAYBACK_MODE_GRANULAR;
+	int requestedQuality = 0;
+
+	struct SettingsCommand {
+		enum Type {
+			SET_PLAYBACK,
+			SET_QUALITY,
+			SET_WORKER,
+		};
+		Type type;
+		int value;
+	};
+	/** Playback and quality changes requested by the UI, applied at the next block */
+	CommandQueue<SettingsCommand> commands;
+
+	/** A block of audio and the settings to process it with, handed to the worker thread */
+	struct Job {
+		clouds::ShortFrame input[32];
+		clouds::ShortFrame output[32];
+		clouds::Parameters parameters;
+		clouds::PlaybackMode playback;
+		int quality;
+	};
+	/** Blocks between handing a job to the worker and playing its output.
+	Rack calls process() for a whole audio buffer in a burst, so the worker needs several blocks of headroom to keep up.
+	*/
+	static constexpr uint32_t WORKER_LATENCY = 8;
+	static constexpr uint32_t WORKER_JOBS = 16;
+	/** How long the worker sleeps when it has no job, so that the audio thread never has to wake it */
+	static constexpr int WORKER_POLL_US = 200;
+	/** How long the worker sleeps while it isn't used */
+	static constexpr int WORKER_IDLE_US = 2000;
+	/** Ring of jobs, where job n is in slot n % WORKER_JOBS */
+	Job jobs[WORKER_JOBS];
+	/** Number of jobs handed to the worker. Only written by the audio thread. */
+	std::atomic<uint32_t> jobsSubmitted{0};
+	/** Number of jobs the worker has finished. Only written by the worker. */
+	std::atomic<uint32_t> jobsCompleted{0};
+	/** Number of the job whose output is played next. Only touched by the audio thread. */
+	uint32_t jobsPlayed = 0;
+	/** Blocks that were output without processed audio because the worker was late */
+	std::atomic<uint32_t> dropouts{0};
+	/** Whether blocks are processed on the worker thread. Only written by the audio thread. */
+	std::atomic<bool> useWorker{false};
+	/** Whether the worker is finishing its jobs before the audio thread processes blocks again */
+	bool workerStopping = false;
+	/** The worker setting as shown in the menu */
+	bool worker = false;
+
+	/** Last block played, which fades out when the next one is missing */
+	clouds::ShortFrame lastOutput[32] = {};
+	/** Whether the output was faded out, so the next block played fades in */
+	bool outputFaded = false;
+
+	std::thread workerThread;
+	std::atomic<bool> workerRunning{false};
 
 	Clouds() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -95,9 +162,10 @@ struct Clouds : Module {
 
 		const int memLen = 118784;
 		const int ccmLen = 65536 - 128;
-		block_mem = new uint8_t[memLen]();
-		block_ccm = new uint8_t[ccmLen]();
-		processor = new clouds::GranularProcessor();
+		arena.init(Arena::sizeOf<uint8_t>(memLen) + Arena::sizeOf<uint8_t>(ccmLen) + Arena::sizeOf<clouds::GranularProcessor>());
+		block_mem = arena.alloc<uint8_t>(memLen);
+		block_ccm = arena.alloc<uint8_t>(ccmLen);
+		processor = new (arena.alloc<clouds::GranularProcessor>()) clouds::GranularProcessor();
 		memset(processor, 0, sizeof(*processor));
 
 		processor->Init(block_mem, memLen, block_ccm, ccmLen);
@@ -105,12 +173,172 @@ struct Clouds : Module {
 	}
 
 	~Clouds() {
-		delete processor;
-		delete[] block_mem;
-		delete[] block_ccm;
+		if (workerThread.joinable()) {
+			workerRunning = false;
+			workerThread.join();
+		}
+		processor->~GranularProcessor();
+	}
+
+	void runWorker() {
+		DenormalGuard denormalGuard;
+		while (workerRunning) {
+			uint32_t completed = jobsCompleted.load(std::memory_order_relaxed);
+			if (completed == jobsSubmitted.load(std::memory_order_acquire)) {
+				std::this_thread::sleep_for(std::chrono::microseconds(useWorker ? WORKER_POLL_US : WORKER_IDLE_US));
+				continue;
+			}
+			processJob(jobs[completed % WORKER_JOBS]);
+			jobsCompleted.store(completed + 1, std::memory_order_release);
+		}
+	}
+
+	void processJob(Job& job) {
+		processor->set_playback_mode(job.playback);
+		processor->set_quality(job.quality);
+		processor->Prepare();
+
+		// Only copy the controls set by setParameters(), since the processor derives the rest
+		clouds::Parameters* p = processor->mutable_parameters();
+		p->trigger = job.parameters.trigger;
+		p->gate = job.parameters.gate;
+		p->freeze = job.parameters.freeze;
+		p->position = job.parameters.position;
+		p->size = job.parameters.size;
+		p->pitch = job.parameters.pitch;
+		p->density = job.parameters.density;
+		p->texture = job.parameters.texture;
+		p->dry_wet = job.parameters.dry_wet;
+		p->stereo_spread = job.parameters.stereo_spread;
+		p->feedback = job.parameters.feedback;
+		p->reverb = job.parameters.reverb;
+
+		processor->Process(job.input, job.output, 32);
+	}
+
+	/** Plays the output of the job handed to the worker WORKER_LATENCY blocks ago, and hands it a new block.
+	Never waits for the worker. If the job isn't finished, the block is counted as a dropout and the output fades out.
+	While the worker is stopping, it is handed no blocks, and its remaining jobs are played as they finish.
+	*/
+	void exchangeJob(const clouds::ShortFrame* input, clouds::ShortFrame* output) {
+		uint32_t submitted = jobsSubmitted.load(std::memory_order_relaxed);
+		uint32_t completed = jobsCompleted.load(std::memory_order_acquire);
+
+		bool due = workerStopping ? (jobsPlayed != submitted) : (submitted - jobsPlayed >= WORKER_LATENCY);
+		if (!due) {
+			playBlock(NULL, output);
+		}
+		else if (completed - jobsPlayed - 1 < WORKER_JOBS) {
+			// Job jobsPlayed is finished
+			playBlock(jobs[jobsPlayed % WORKER_JOBS].output, output);
+			jobsPlayed++;
+		}
+		else if (!workerStopping) {
+			// The job will still be processed, so the processor's state stays continuous, but its output is skipped
+			playBlock(NULL, output);
+			jobsPlayed++;
+			dropouts++;
+		}
+		else {
+			playBlock(NULL, output);
+		}
+
+		if (workerStopping) {
+			if (jobsPlayed == submitted && jobsCompleted.load(std::memory_order_acquire) == submitted) {
+				// The worker is idle, so the processor can be used here again
+				workerStopping = false;
+				useWorker = false;
+				fadeOut(output);
+				outputFaded = true;
+			}
+			return;
+		}
+
+		// Skip the block if the worker is so far behind that every slot is taken
+		if (submitted - completed >= WORKER_JOBS) {
+			dropouts++;
+			return;
+		}
+		Job& job = jobs[submitted % WORKER_JOBS];
+		std::memcpy(job.input, input, sizeof(job.input));
+		job.playback = playback;
+		job.quality = quality;
+		setParameters(&job.parameters);
+		jobsSubmitted.store(submitted + 1, std::memory_order_release);
+	}
+
+	/** Copies `block` to `output`, or fades out the last block if `block` is NULL, so gaps in the output don't click. */
+	void playBlock(const clouds::ShortFrame* block, clouds::ShortFrame* output) {
+		if (!block) {
+			if (outputFaded) {
+				std::memset(output, 0, sizeof(lastOutput));
+			}
+			else {
+				std::memcpy(output, lastOutput, sizeof(lastOutput));
+				fadeOut(output);
+				outputFaded = true;
+			}
+			return;
+		}
+		std::memcpy(lastOutput, block, sizeof(lastOutput));
+		std::memcpy(output, block, sizeof(lastOutput));
+		if (outputFaded) {
+			for (int i = 0; i < 32; i++) {
+				output[i].l = output[i].l * (i + 1) / 32;
+				output[i].r = output[i].r * (i + 1) / 32;
+			}
+			outputFaded = false;
+		}
+	}
+
+	static void fadeOut(clouds::ShortFrame* block) {
+		for (int i = 0; i < 32; i++) {
+			block[i].l = block[i].l * (31 - i) / 32;
+			block[i].r = block[i].r * (31 - i) / 32;
+		}
+	}
+
+	void setParameters(clouds::Parameters* p) {
+		p->trigger = triggered;
+		p->gate = triggered;
+		p->freeze = freeze || (inputs[FREEZE_INPUT].getVoltage() >= 1.0);
+		p->position = clamp(params[POSITION_PARAM].getValue() + inputs[POSITION_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
+		p->size = clamp(params[SIZE_PARAM].getValue() + inputs[SIZE_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
+		p->pitch = clamp((params[PITCH_PARAM].getValue() + inputs[PITCH_INPUT].getVoltage()) * 12.0f, -48.0f, 48.0f);
+		p->density = clamp(params[DENSITY_PARAM].getValue() + inputs[DENSITY_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
+		p->texture = clamp(params[TEXTURE_PARAM].getValue() + inputs[TEXTURE_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
+		p->dry_wet = params[BLEND_PARAM].getValue();
+		p->stereo_spread = params[SPREAD_PARAM].getValue();
+		p->feedback = params[FEEDBACK_PARAM].getValue();
+		// TODO
+		// Why doesn't dry audio get reverbed?
+		p->reverb = params[REVERB_PARAM].getValue();
+		float blend = inputs[BLEND_INPUT].getVoltage() / 5.0f;
+		switch (blendMode) {
+			case 0:
+				p->dry_wet += blend;
+				p->dry_wet = clamp(p->dry_wet, 0.0f, 1.0f);
+				break;
+			case 1:
+				p->stereo_spread += blend;
+				p->stereo_spread = clamp(p->stereo_spread, 0.0f, 1.0f);
+				break;
+			case 2:
+				p->feedback += blend;
+				p->feedback = clamp(p->feedback, 0.0f, 1.0f);
+				break;
+			case 3:
+				p->reverb += blend;
+				p->reverb = clamp(p->reverb, 0.0f, 1.0f);
+				break;
+		}
+		frozen = p->freeze;
 	}
 
 	void process(const ProcessArgs& args) override {
+		DenormalGuard denormalGuard;
+		qualityTier.apply();
+
 		// Get input
 		dsp::Frame<2> inputFrame = {};
 		if (!inputBuffer.full()) {
@@ -137,6 +365,7 @@ struct Clouds : Module {
 			// Convert input buffer
 			{
 				inputSrc.setRates(args.sampleRate, 32000);
+				inputSrc.setQuality(getSrcQuality(qualityTier.tier));
 				dsp::Frame<2> inputFrames[32];
 				int inLen = inputBuffer.size();
 				int outLen = 32;
@@ -151,47 +380,53 @@ struct Clouds : Module {
 			}
 
 			// Set up processor
-			processor->set_playback_mode(playback);
-			processor->set_quality(quality);
-			processor->Prepare();
-
-			clouds::Parameters* p = processor->mutable_parameters();
-			p->trigger = triggered;
-			p->gate = triggered;
-			p->freeze = freeze || (inputs[FREEZE_INPUT].getVoltage() >= 1.0);
-			p->position = clamp(params[POSITION_PARAM].getValue() + inputs[POSITION_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
-			p->size = clamp(params[SIZE_PARAM].getValue() + inputs[SIZE_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
-			p->pitch = clamp((params[PITCH_PARAM].getValue() + inputs[PITCH_INPUT].getVoltage()) * 12.0f, -48.0f, 48.0f);
-			p->density = clamp(params[DENSITY_PARAM].getValue() + inputs[DENSITY_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
-			p->texture = clamp(params[TEXTURE_PARAM].getValue() + inputs[TEXTURE_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
-			p->dry_wet = params[BLEND_PARAM].getValue();
-			p->stereo_spread = params[SPREAD_PARAM].getValue();
-			p->feedback = params[FEEDBACK_PARAM].getValue();
-			// TODO
-			// Why doesn't dry audio get reverbed?
-			p->reverb = params[REVERB_PARAM].getValue();
-			float blend = inputs[BLEND_INPUT].getVoltage() / 5.0f;
-			switch (blendMode) {
-				case 0:
-					p->dry_wet += blend;
-					p->dry_wet = clamp(p->dry_wet, 0.0f, 1.0f);
-					break;
-				case 1:
-					p->stereo_spread += blend;
-					p->stereo_spread = clamp(p->stereo_spread, 0.0f, 1.0f);
-					break;
-				case 2:
-					p->feedback += blend;
-					p->feedback = clamp(p->feedback, 0.0f, 1.0f);
-					break;
-				case 3:
-					p->reverb += blend;
-					p->reverb = clamp(p->reverb, 0.0f, 1.0f);
-					break;
-			}
+			bool startWorker = false;
+			commands.drain([&](const SettingsCommand& command) {
+				switch (command.type) {
+					case SettingsCommand::SET_PLAYBACK:
+						playback = (clouds::PlaybackMode) command.value;
+						break;
+					case SettingsCommand::SET_QUALITY:
+						quality = command.value;
+						break;
+					case SettingsCommand::SET_WORKER:
+						if (command.value) {
+							if (!useWorker)
+								startWorker = true;
+							// If the worker is stopping, keep using it and its queued jobs
+							workerStopping = false;
+						}
+						else {
+							startWorker = false;
+							// The worker finishes its jobs before the processor is used here again
+							if (useWorker)
+								workerStopping = true;
+						}
+						break;
+				}
+			});
 
 			clouds::ShortFrame output[32];
-			processor->Process(input, output, 32);
+			if (useWorker) {
+				exchangeJob(input, output);
+			}
+			else {
+				clouds::ShortFrame block[32];
+				processor->set_playback_mode(playback);
+				processor->set_quality(quality);
+				processor->Prepare();
+				setParameters(processor->mutable_parameters());
+				processor->Process(input, block, 32);
+				playBlock(block, output);
+				if (startWorker) {
+					// The worker's first output comes WORKER_LATENCY blocks later, so fade out until then
+					fadeOut(output);
+					outputFaded = true;
+					useWorker = true;
+					jobsPlayed = jobsSubmitted.load(std::memory_order_relaxed);
+					dropouts = 0;
+				}
+			}
 
 			// Convert output buffer
 			{
@@ -202,6 +437,7 @@ struct Clouds : Module {
 				}
 
 				outputSrc.setRates(32000, args.sampleRate);
+				outputSrc.setQuality(getSrcQuality(qualityTier.tier));
 				int inLen = 32;
 				int outLen = outputBuffer.capacity();
 				outputSrc.process(outputFrames, &inLen, outputBuffer.endData(), &outLen);
@@ -218,14 +454,14 @@ struct Clouds : Module {
 			outputs[OUT_L_OUTPUT].setVoltage(5.0 * outputFrame.samples[0]);
 			outputs[OUT_R_OUTPUT].setVoltage(5.0 * outputFrame.samples[1]);
 		}
+		recorder.process(this, args.sampleRate);
 
 		// Lights
-		clouds::Parameters* p = processor->mutable_parameters();
 		dsp::VuMeter vuMeter;
 		vuMeter.dBInterval = 6.0;
-		dsp::Frame<2> lightFrame = p->freeze ? outputFrame : inputFrame;
+		dsp::Frame<2> lightFrame = frozen ? outputFrame : inputFrame;
 		vuMeter.setValue(fmaxf(fabsf(lightFrame.samples[0]), fabsf(lightFrame.samples[1])));
-		lights[FREEZE_LIGHT].setBrightness(p->freeze ? 0.75 : 0.0);
+		lights[FREEZE_LIGHT].setBrightness(frozen ? 0.75 : 0.0);
 		lights[MIX_GREEN_LIGHT].setSmoothBrightness(vuMeter.getBrightness(3), args.sampleTime);
 		lights[PAN_GREEN_LIGHT].setSmoothBrightness(vuMeter.getBrightness(2), args.sampleTime);
 		lights[FEEDBACK_GREEN_LIGHT].setSmoothBrightness(vuMeter.getBrightness(1), args.sampleTime);
@@ -239,16 +475,39 @@ struct Clouds : Module {
 	void onReset() override {
 		freeze = false;
 		blendMode = 0;
-		playback = clouds::PLAYBACK_MODE_GRANULAR;
-		quality = 0;
+		setPlayback(clouds::PLAYBACK_MODE_GRANULAR);
+		setQuality(0);
+		setWorker(false);
+	}
+
+	void setPlayback(clouds::PlaybackMode playback) {
+		requestedPlayback = playback;
+		commands.push({SettingsCommand::SET_PLAYBACK, (int) playback});
+	}
+
+	void setQuality(int quality) {
+		requestedQuality = quality;
+		commands.push({SettingsCommand::SET_QUALITY, quality});
+	}
+
+	void setWorker(bool worker) {
+		// Start the thread here rather than on the audio thread. It sleeps while unused.
+		if (worker && !workerThread.joinable()) {
+			workerRunning = true;
+			workerThread = std::thread([this]() {runWorker();});
+		}
+		this->worker = worker;
+		commands.push({SettingsCommand::SET_WORKER, worker});
 	}
 
 	json_t* dataToJson() override {
 		json_t* rootJ = json_object();
 
-		json_object_set_new(rootJ, "playback", json_integer((int) playback));
-		json_object_set_new(rootJ, "quality", json_integer(quality));
+		json_object_set_new(rootJ, "playback", json_integer((int) requestedPlayback));
+		json_object_set_new(rootJ, "quality", json_integer(requestedQuality));
 		json_object_set_new(rootJ, "blendMode", json_integer(blendMode));
+		json_object_set_new(rootJ, "worker", json_boolean(worker));
+		json_object_set_new(rootJ, "qualityTier", json_integer(qualityTier.requested));
 
 		return rootJ;
 	}
@@ -256,18 +515,25 @@ struct Clouds : Module {
 	void dataFromJson(json_t* rootJ) override {
 		json_t* playbackJ = json_object_get(rootJ, "playback");
 		if (playbackJ) {
-			playback = (clouds::PlaybackMode) json_integer_value(playbackJ);
+			setPlayback((clouds::PlaybackMode) json_integer_value(playbackJ));
 		}
 
 		json_t* qualityJ = json_object_get(rootJ, "quality");
 		if (qualityJ) {
-			quality = json_integer_value(qualityJ);
+			setQuality(json_integer_value(qualityJ));
 		}
 
 		json_t* blendModeJ = json_object_get(rootJ, "blendMode");
 		if (blendModeJ) {
 			blendMode = json_integer_value(blendModeJ);
 		}
+
+		json_t* workerJ = json_object_get(rootJ, "worker");
+		if (workerJ) {
+			setWorker(json_boolean_value(workerJ));
+		}
+
+		qualityTierFromJson(rootJ, &qualityTier);
 	}
 };
 
@@ -383,13 +649,13 @@ struct CloudsWidget : ModuleWidget {
 		};
 		for (int i = 0; i < (int) playbackLabels.size(); i++) {
 			menu->addChild(createCheckMenuItem(playbackLabels[i],
-				[=]() {return module->playback == i;},
-				[=]() {module->playback = (clouds::PlaybackMode) i;}
+				[=]() {return module->requestedPlayback == i;},
+				[=]() {module->setPlayback((clouds::PlaybackMode) i);}
 			));
 		}
 
 		menu->addChild(new MenuSeparator);
-		menu->addChild(createMenuLabel("Quality"));
+		menu->addChild(createMenuLabel("Buffer length and resolution"));
 
 		static const std::vector<std::string> qualityLabels = {
 			"1s 32kHz 16-bit stereo",
@@ -399,10 +665,20 @@ struct CloudsWidget : ModuleWidget {
 		};
 		for (int i = 0; i < (int) qualityLabels.size(); i++) {
 			menu->addChild(createCheckMenuItem(qualityLabels[i],
-				[=]() {return module->quality == i;},
-				[=]() {module->quality = i;}
+				[=]() {return module->requestedQuality == i;},
+				[=]() {module->setQuality(i);}
 			));
 		}
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createBoolMenuItem("Process on worker thread (adds 8 ms latency)",
+			[=]() {return module->worker;},
+			[=](bool val) {module->setWorker(val);}
+		));
+		if (module->worker)
+			menu->addChild(createMenuLabel(string::f("Worker dropouts: %u", (unsigned) module->dropouts)));
+		appendQualityMenu(menu, &module->qualityTier);
+		appendRecorderMenu(menu, &module->recorder, module, {Clouds::OUT_L_OUTPUT, Clouds::OUT_R_OUTPUT});
 	}
 };
 
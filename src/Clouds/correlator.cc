@@ -0,0 +1,231 @@
+// Copyright 2014 Emilie Gillet.
+//
+// Author: Emilie Gillet (emilie.o.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Search for the best splice point in the WSOLA sample player.
+//
+// Replaces the firmware's correlator.cc, which the Makefile leaves out, and
+// implements the firmware's header unchanged. Candidates are scored the same
+// way, by the number of equal bits of the sign-quantized source and
+// destination, and ties go to the earliest candidate.
+//
+// The firmware shifts the destination again for every candidate and counts
+// bits with shifts and masks 32 at a time. Here candidates are visited by bit
+// offset: candidates 32 bits apart share the same shifted destination, so it
+// is shifted once for a run of them, and the bits are counted 64 at a time
+// with the CPU's popcount instruction. Like the firmware, a search is spread
+// over several calls of EvaluateSomeCandidates(), so no single block pays for
+// the whole window. The window size is chosen by the WSOLA player, which
+// packs the bits the search reads.
+
+#include "clouds/dsp/correlator.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace clouds
+{
+
+namespace
+{
+
+// Longest shifted destination the fast search handles, enough for windows of
+// 8192 samples. Longer windows are searched one candidate at a time.
+const uint32_t kMaxShiftedWords = 512;
+
+// A search evaluates a sixteenth of its window, plus 16 candidates, per call
+// of EvaluateSomeCandidates(), so it ends within 16 calls.
+inline int32_t CandidatesPerCall(int32_t size)
+{
+    return (size >> 4) + 16;
+}
+
+inline uint32_t PopCount(uint64_t x)
+{
+    return static_cast<uint32_t>(__builtin_popcountll(x));
+}
+
+// Destination word at a bit offset of shift, with bits read MSB first as the
+// player packs them. A shift of 0 moves the second word out entirely, where
+// the firmware's 32-bit shift by 32 was undefined.
+inline uint32_t Shifted(const uint32_t* destination, uint32_t shift)
+{
+    uint64_t d = (static_cast<uint64_t>(destination[0]) << 32) |
+        destination[1];
+    return static_cast<uint32_t>((d << shift) >> 32);
+}
+
+// Number of different bits of two runs of num_words words. Words are paired
+// in memory order, which doesn't change the count.
+inline uint32_t Distance(
+    const uint32_t* a,
+    const uint32_t* b,
+    uint32_t num_words)
+{
+    uint32_t distance = 0;
+    uint32_t i = 0;
+    for (; i + 2 <= num_words; i += 2)
+    {
+        uint64_t x;
+        uint64_t y;
+        memcpy(&x, &a[i], sizeof(x));
+        memcpy(&y, &b[i], sizeof(y));
+        distance += PopCount(x ^ y);
+    }
+    if (i < num_words)
+    {
+        distance += PopCount(a[i] ^ b[i]);
+    }
+    return distance;
+}
+
+// Candidates are visited by bit offset, then by word: the k-th candidate of a
+// window of size bits has the bit offset *shift and the word offset *word.
+// The first size % 32 bit offsets have one candidate more than the others.
+inline void Locate(int32_t k, int32_t size, int32_t* shift, int32_t* word)
+{
+    int32_t per_shift = size >> 5;
+    int32_t long_shifts = size & 0x1f;
+    int32_t long_candidates = long_shifts * (per_shift + 1);
+    if (k < long_candidates)
+    {
+        *shift = k / (per_shift + 1);
+        *word = k % (per_shift + 1);
+    }
+    else
+    {
+        k -= long_candidates;
+        *shift = long_shifts + k / per_shift;
+        *word = k % per_shift;
+    }
+}
+
+}  // namespace
+
+void Correlator::Init(uint32_t* source, uint32_t* destination)
+{
+    source_ = source;
+    destination_ = destination;
+    offset_ = 0;
+    best_match_ = 0;
+    done_ = true;
+}
+
+void Correlator::EvaluateSomeCandidates()
+{
+    if (done_)
+    {
+        return;
+    }
+    uint32_t num_words = size_ >> 5;
+    uint32_t num_shifted = ((size_ - 1) >> 5) + num_words;
+    int32_t end = candidate_ + CandidatesPerCall(size_);
+    if (end > size_)
+    {
+        end = size_;
+    }
+    if (num_shifted > kMaxShiftedWords)
+    {
+        while (candidate_ < end)
+        {
+            EvaluateNextCandidate();
+        }
+        return;
+    }
+
+    uint32_t bits = num_words << 5;
+    uint32_t shifted[kMaxShiftedWords];
+    while (candidate_ < end)
+    {
+        // Run of candidates with the same bit offset
+        int32_t shift;
+        int32_t first;
+        Locate(candidate_, size_, &shift, &first);
+        int32_t last = (size_ - shift + 31) >> 5;
+        if (last - first > end - candidate_)
+        {
+            last = first + (end - candidate_);
+        }
+        for (uint32_t j = first; j < last - 1 + num_words; ++j)
+        {
+            shifted[j - first] = Shifted(&destination_[j], shift);
+        }
+        for (int32_t word = first; word < last; ++word)
+        {
+            int32_t candidate = (word << 5) + shift;
+            uint32_t score = bits -
+                Distance(source_, &shifted[word - first], num_words);
+            if (score > best_score_ ||
+                (score == best_score_ && candidate < best_match_))
+            {
+                best_match_ = candidate;
+                best_score_ = score;
+            }
+        }
+        candidate_ += last - first;
+    }
+    done_ = candidate_ >= size_;
+}
+
+bool Correlator::EvaluateNextCandidate()
+{
+    if (done_)
+    {
+        return true;
+    }
+    int32_t shift;
+    int32_t word;
+    Locate(candidate_, size_, &shift, &word);
+    int32_t candidate = (word << 5) + shift;
+    uint32_t num_words = size_ >> 5;
+    const uint32_t* destination = &destination_[word];
+    uint32_t score = 0;
+    for (uint32_t i = 0; i < num_words; ++i)
+    {
+        score += PopCount(~(source_[i] ^ Shifted(&destination[i], shift)));
+    }
+    if (score > best_score_ ||
+        (score == best_score_ && candidate < best_match_))
+    {
+        best_match_ = candidate;
+        best_score_ = score;
+    }
+    ++candidate_;
+    done_ = candidate_ >= size_;
+    return done_;
+}
+
+void Correlator::StartSearch(int32_t size, int32_t offset, int32_t increment)
+{
+    offset_ = offset;
+    increment_ = increment;
+    best_score_ = 0;
+    best_match_ = 0;
+    candidate_ = 0;
+    size_ = size;
+    done_ = false;
+}
+
+}  // namespace clouds
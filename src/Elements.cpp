@@ -70,13 +70,35 @@ struct Elements : Module {
 		NUM_LIGHTS
 	};
 
-	dsp::SampleRateConverter<16 * 2> inputSrc;
-	dsp::SampleRateConverter<16 * 2> outputSrc;
-	dsp::DoubleRingBuffer<dsp::Frame<16 * 2>, 256> inputBuffer;
-	dsp::DoubleRingBuffer<dsp::Frame<16 * 2>, 256> outputBuffer;
-
-	uint16_t reverb_buffers[16][32768] = {};
+	PlanarSampleRateConverter<16 * 2> inputSrc;
+	PlanarSampleRateConverter<16 * 2> outputSrc;
+	/** Blow of voice c in channel c, strike in channel 16 + c */
+	PlanarRingBuffer<16 * 2, 256> inputBuffer;
+	/** Main of voice c in channel c, aux in channel 16 + c */
+	PlanarBlockBuffer<16 * 2, 256> outputBuffer;
+	QualityTierSetting qualityTier;
+	Recorder recorder;
+
+	Arena arena;
+	/** Reverb delay memory, carved from the arena apart from the parts' state */
+	uint16_t (*reverb_buffers)[32768];
+	/** All 16 parts in one array, so the first few voices are adjacent in memory */
+	elements::Part* partStorage;
 	elements::Part* parts[16];
+	/** Resonator models requested by the UI, applied at the next block */
+	CommandQueue<int> modelCommands;
+	/** The model as last requested, which the menu and dataToJson() show before the audio thread applies it */
+	int model = 0;
+
+	static constexpr int NUM_MOD_INPUTS = NUM_INPUTS - BOW_TIMBRE_MOD_INPUT;
+	/** Change in a mod input, in volts, below which a voice keeps its patch */
+	static constexpr float PATCH_EPSILON = 1e-3f;
+	/** Mod input voltages of each voice when its patch was last set */
+	float patchInputs[16][NUM_MOD_INPUTS] = {};
+	/** Param values when the patches were last set */
+	float patchParams[NUM_PARAMS] = {};
+	/** Number of channels when the patches were last set, or 0 if they must all be set */
+	int patchChannels = 0;
 
 	Elements() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -129,8 +151,11 @@ struct Elements : Module {
 		configOutput(AUX_OUTPUT, "Left");
 		configOutput(MAIN_OUTPUT, "Right");
 
+		arena.init(Arena::sizeOf<uint16_t[32768]>(16) + Arena::sizeOf<elements::Part>(16));
+		reverb_buffers = arena.alloc<uint16_t[32768]>(16);
+		partStorage = arena.alloc<elements::Part>(16);
 		for (int c = 0; c < 16; c++) {
-			parts[c] = new elements::Part();
+			parts[c] = new (&partStorage[c]) elements::Part();
 			// In the Mutable Instruments code, Part doesn't initialize itself, so zero it here.
 			std::memset(parts[c], 0, sizeof(*parts[c]));
 			parts[c]->Init(reverb_buffers[c]);
@@ -142,7 +167,7 @@ struct Elements : Module {
 
 	~Elements() {
 		for (int c = 0; c < 16; c++) {
-			delete parts[c];
+			parts[c]->~Part();
 		}
 	}
 
@@ -151,40 +176,51 @@ struct Elements : Module {
 	}
 
 	void process(const ProcessArgs& args) override {
+		DenormalGuard denormalGuard;
+		qualityTier.apply();
+
 		int channels = std::max(inputs[NOTE_INPUT].getChannels(), 1);
 
 		// Get input
 		if (!inputBuffer.full()) {
-			dsp::Frame<16 * 2> inputFrame = {};
+			float blowIn[16], strikeIn[16];
+			loadPolyVoltages(inputs[BLOW_INPUT], blowIn, channels);
+			loadPolyVoltages(inputs[STRIKE_INPUT], strikeIn, channels);
 			for (int c = 0; c < channels; c++) {
-				inputFrame.samples[c * 2 + 0] = inputs[BLOW_INPUT].getPolyVoltage(c) / 5.0;
-				inputFrame.samples[c * 2 + 1] = inputs[STRIKE_INPUT].getPolyVoltage(c) / 5.0;
+				inputBuffer.write(c, blowIn[c] / 5.f);
+				inputBuffer.write(16 + c, strikeIn[c] / 5.f);
 			}
-			inputBuffer.push(inputFrame);
+			inputBuffer.endIncr();
 		}
 
 		// Generate output if output buffer is empty
 		if (outputBuffer.empty()) {
+			modelCommands.drain([&](int model) {
+				applyModel(model);
+			});
+
 			// blow[channel][bufferIndex]
 			float blow[16][16] = {};
 			float strike[16][16] = {};
 
-			// Convert input buffer
+			// Convert input buffer straight into each voice's blow and strike buffers
 			{
+				float* in[16 * 2];
+				float* out[16 * 2];
+				for (int c = 0; c < channels; c++) {
+					in[c] = inputBuffer.startData(c);
+					out[c] = blow[c];
+					in[channels + c] = inputBuffer.startData(16 + c);
+					out[channels + c] = strike[c];
+				}
+
 				inputSrc.setRates(args.sampleRate, 32000);
+				inputSrc.setQuality(getSrcQuality(qualityTier.tier));
 				inputSrc.setChannels(channels * 2);
 				int inLen = inputBuffer.size();
 				int outLen = 16;
-				dsp::Frame<16 * 2> inputFrames[outLen];
-				inputSrc.process(inputBuffer.startData(), &inLen, inputFrames, &outLen);
+				inputSrc.process(in, &inLen, out, &outLen);
 				inputBuffer.startIncr(inLen);
-
-				for (int c = 0; c < channels; c++) {
-					for (int i = 0; i < outLen; i++) {
-						blow[c][i] = inputFrames[i].samples[c * 2 + 0];
-						strike[c][i] = inputFrames[i].samples[c * 2 + 1];
-					}
-				}
 			}
 
 			// Process channels
@@ -195,31 +231,63 @@ struct Elements : Module {
 			float exciterLight = 0.f;
 			float resonatorLight = 0.f;
 
+			// A voice's patch is only set again when a param changes or one of its mod inputs moves by more than PATCH_EPSILON.
+			// This skips the work done here, but elements::Part still recomputes the resonator's coefficients from the patch on every block.
+			bool paramsChanged = (channels != patchChannels);
+			patchChannels = channels;
+			for (int i = 0; i < NUM_PARAMS; i++) {
+				float value = params[i].getValue();
+				if (value != patchParams[i]) {
+					patchParams[i] = value;
+					paramsChanged = true;
+				}
+			}
+
+			// Attenuverter curves are the same for every voice, so they are computed once per block
+			float modAmounts[NUM_PARAMS] = {};
+			for (int paramId : {BOW_TIMBRE_MOD_PARAM, FLOW_MOD_PARAM, BLOW_TIMBRE_MOD_PARAM, MALLET_MOD_PARAM, STRIKE_TIMBRE_MOD_PARAM, GEOMETRY_MOD_PARAM, BRIGHTNESS_MOD_PARAM, DAMPING_MOD_PARAM, POSITION_MOD_PARAM}) {
+				modAmounts[paramId] = 3.3f * dsp::quadraticBipolar(params[paramId].getValue()) / 5.f;
+			}
+			float fmAmount = 3.3f * dsp::quarticBipolar(params[FM_PARAM].getValue()) * 49.5f / 5.f;
+			float spaceModAmount = params[SPACE_MOD_PARAM].getValue() / 5.f;
+
 			for (int c = 0; c < channels; c++) {
-				// Set patch from parameters
-				elements::Patch* p = parts[c]->mutable_patch();
-				p->exciter_envelope_shape = params[CONTOUR_PARAM].getValue();
-				p->exciter_bow_level = params[BOW_PARAM].getValue();
-				p->exciter_blow_level = params[BLOW_PARAM].getValue();
-				p->exciter_strike_level = params[STRIKE_PARAM].getValue();
-
-#define BIND(_p, _m, _i) clamp(params[_p].getValue() + 3.3f * dsp::quadraticBipolar(params[_m].getValue()) * inputs[_i].getPolyVoltage(c) / 5.f, 0.f, 0.9995f)
-
-				p->exciter_bow_timbre = BIND(BOW_TIMBRE_PARAM, BOW_TIMBRE_MOD_PARAM, BOW_TIMBRE_MOD_INPUT);
-				p->exciter_blow_meta = BIND(FLOW_PARAM, FLOW_MOD_PARAM, FLOW_MOD_INPUT);
-				p->exciter_blow_timbre = BIND(BLOW_TIMBRE_PARAM, BLOW_TIMBRE_MOD_PARAM, BLOW_TIMBRE_MOD_INPUT);
-				p->exciter_strike_meta = BIND(MALLET_PARAM, MALLET_MOD_PARAM, MALLET_MOD_INPUT);
-				p->exciter_strike_timbre = BIND(STRIKE_TIMBRE_PARAM, STRIKE_TIMBRE_MOD_PARAM, STRIKE_TIMBRE_MOD_INPUT);
-				p->resonator_geometry = BIND(GEOMETRY_PARAM, GEOMETRY_MOD_PARAM, GEOMETRY_MOD_INPUT);
-				p->resonator_brightness = BIND(BRIGHTNESS_PARAM, BRIGHTNESS_MOD_PARAM, BRIGHTNESS_MOD_INPUT);
-				p->resonator_damping = BIND(DAMPING_PARAM, DAMPING_MOD_PARAM, DAMPING_MOD_INPUT);
-				p->resonator_position = BIND(POSITION_PARAM, POSITION_MOD_PARAM, POSITION_MOD_INPUT);
-				p->space = clamp(params[SPACE_PARAM].getValue() + params[SPACE_MOD_PARAM].getValue() * inputs[SPACE_MOD_INPUT].getPolyVoltage(c) / 5.f, 0.f, 2.f);
+				float modInputs[NUM_MOD_INPUTS];
+				bool moved = paramsChanged;
+				for (int i = 0; i < NUM_MOD_INPUTS; i++) {
+					modInputs[i] = inputs[BOW_TIMBRE_MOD_INPUT + i].getPolyVoltage(c);
+					if (std::fabs(modInputs[i] - patchInputs[c][i]) > PATCH_EPSILON)
+						moved = true;
+				}
+
+				if (moved) {
+					std::memcpy(patchInputs[c], modInputs, sizeof(modInputs));
+
+					// Set patch from parameters
+					elements::Patch* p = parts[c]->mutable_patch();
+					p->exciter_envelope_shape = params[CONTOUR_PARAM].getValue();
+					p->exciter_bow_level = params[BOW_PARAM].getValue();
+					p->exciter_blow_level = params[BLOW_PARAM].getValue();
+					p->exciter_strike_level = params[STRIKE_PARAM].getValue();
+
+#define BIND(_p, _m, _i) clamp(params[_p].getValue() + modAmounts[_m] * modInputs[_i - BOW_TIMBRE_MOD_INPUT], 0.f, 0.9995f)
+
+					p->exciter_bow_timbre = BIND(BOW_TIMBRE_PARAM, BOW_TIMBRE_MOD_PARAM, BOW_TIMBRE_MOD_INPUT);
+					p->exciter_blow_meta = BIND(FLOW_PARAM, FLOW_MOD_PARAM, FLOW_MOD_INPUT);
+					p->exciter_blow_timbre = BIND(BLOW_TIMBRE_PARAM, BLOW_TIMBRE_MOD_PARAM, BLOW_TIMBRE_MOD_INPUT);
+					p->exciter_strike_meta = BIND(MALLET_PARAM, MALLET_MOD_PARAM, MALLET_MOD_INPUT);
+					p->exciter_strike_timbre = BIND(STRIKE_TIMBRE_PARAM, STRIKE_TIMBRE_MOD_PARAM, STRIKE_TIMBRE_MOD_INPUT);
+					p->resonator_geometry = BIND(GEOMETRY_PARAM, GEOMETRY_MOD_PARAM, GEOMETRY_MOD_INPUT);
+					p->resonator_brightness = BIND(BRIGHTNESS_PARAM, BRIGHTNESS_MOD_PARAM, BRIGHTNESS_MOD_INPUT);
+					p->resonator_damping = BIND(DAMPING_PARAM, DAMPING_MOD_PARAM, DAMPING_MOD_INPUT);
+					p->resonator_position = BIND(POSITION_PARAM, POSITION_MOD_PARAM, POSITION_MOD_INPUT);
+					p->space = clamp(params[SPACE_PARAM].getValue() + spaceModAmount * modInputs[SPACE_MOD_INPUT - BOW_TIMBRE_MOD_INPUT], 0.f, 2.f);
+				}
 
 				// Get performance inputs
 				elements::PerformanceState performance;
 				performance.note = 12.f * inputs[NOTE_INPUT].getVoltage(c) + std::round(params[COARSE_PARAM].getValue()) + params[FINE_PARAM].getValue() + 69.f;
-				performance.modulation = 3.3f * dsp::quarticBipolar(params[FM_PARAM].getValue()) * 49.5f * inputs[FM_INPUT].getPolyVoltage(c) / 5.f;
+				performance.modulation = fmAmount * inputs[FM_INPUT].getPolyVoltage(c);
 				performance.gate = params[PLAY_PARAM].getValue() >= 1.f || inputs[GATE_INPUT].getPolyVoltage(c) >= 1.f;
 				performance.strength = clamp(1.f - inputs[STRENGTH_INPUT].getPolyVoltage(c) / 5.f, 0.f, 1.f);
 
@@ -237,41 +305,49 @@ struct Elements : Module {
 			lights[EXCITER_LIGHT].setBrightness(exciterLight);
 			lights[RESONATOR_LIGHT].setBrightness(resonatorLight);
 
-			// Convert output buffer
+			// Convert output buffer straight from each voice's main and aux buffers
 			{
-				dsp::Frame<16 * 2> outputFrames[16];
+				float* in[16 * 2];
+				float* out[16 * 2];
 				for (int c = 0; c < channels; c++) {
-					for (int i = 0; i < 16; i++) {
-						outputFrames[i].samples[c * 2 + 0] = main[c][i];
-						outputFrames[i].samples[c * 2 + 1] = aux[c][i];
-					}
+					in[c] = main[c];
+					out[c] = outputBuffer.data[c];
+					in[channels + c] = aux[c];
+					out[channels + c] = outputBuffer.data[16 + c];
 				}
 
 				outputSrc.setRates(32000, args.sampleRate);
+				outputSrc.setQuality(getSrcQuality(qualityTier.tier));
 				outputSrc.setChannels(channels * 2);
 				int inLen = 16;
 				int outLen = outputBuffer.capacity();
-				outputSrc.process(outputFrames, &inLen, outputBuffer.endData(), &outLen);
-				outputBuffer.endIncr(outLen);
+				outputSrc.process(in, &inLen, out, &outLen);
+				outputBuffer.fill(outLen);
 			}
 		}
 
 		// Set output
 		if (!outputBuffer.empty()) {
-			dsp::Frame<16 * 2> outputFrame = outputBuffer.shift();
+			float auxOut[16] = {}, mainOut[16] = {};
 			for (int c = 0; c < channels; c++) {
-				outputs[AUX_OUTPUT].setVoltage(5.f * outputFrame.samples[c * 2 + 0], c);
-				outputs[MAIN_OUTPUT].setVoltage(5.f * outputFrame.samples[c * 2 + 1], c);
+				auxOut[c] = 5.f * outputBuffer.get(c);
+				mainOut[c] = 5.f * outputBuffer.get(16 + c);
 			}
+			storeVoltages(outputs[AUX_OUTPUT], auxOut, channels);
+			storeVoltages(outputs[MAIN_OUTPUT], mainOut, channels);
+			outputBuffer.shift();
 		}
 
 		outputs[AUX_OUTPUT].setChannels(channels);
 		outputs[MAIN_OUTPUT].setChannels(channels);
+
+		recorder.process(this, args.sampleRate);
 	}
 
 	json_t* dataToJson() override {
 		json_t* rootJ = json_object();
 		json_object_set_new(rootJ, "model", json_integer(getModel()));
+		json_object_set_new(rootJ, "qualityTier", json_integer(qualityTier.requested));
 		return rootJ;
 	}
 
@@ -280,19 +356,24 @@ struct Elements : Module {
 		if (modelJ) {
 			setModel(json_integer_value(modelJ));
 		}
+
+		qualityTierFromJson(rootJ, &qualityTier);
 	}
 
 	int getModel() {
-		// Use the first channel's Part as the reference model
-		if (parts[0]->easter_egg())
-			return -1;
-		return (int) parts[0]->resonator_model();
+		return model;
 	}
 
 	/** Sets the resonator model.
 	-1 means easter egg (Ominous voice)
+	The change is applied by the audio thread at the start of the next block.
 	*/
 	void setModel(int model) {
+		this->model = model;
+		modelCommands.push(model);
+	}
+
+	void applyModel(int model) {
 		if (model < 0) {
 			for (int c = 0; c < 16; c++) {
 				parts[c]->set_easter_egg(true);
@@ -406,6 +487,10 @@ struct ElementsWidget : ModuleWidget {
 				[=]() {module->setModel(i);}
 			));
 		}
+
+		menu->addChild(new MenuSeparator);
+		appendQualityMenu(menu, &module->qualityTier);
+		appendRecorderMenu(menu, &module->recorder, module, {Elements::AUX_OUTPUT, Elements::MAIN_OUTPUT});
 	}
 };
 
@@ -45,6 +45,10 @@ struct Frames : Module {
 	frames::PolyLfo poly_lfo;
 	bool poly_lfo_mode = false;
 	uint16_t lastControls[4] = {};
+	/** Knob values last applied to the poly LFO */
+	uint16_t lfoControls[4] = {};
+	/** Scans the knobs in poly LFO mode, where they only set the LFO shape and don't need per-sample resolution */
+	dsp::ClockDivider lfoControlDivider;
 
 	dsp::SchmittTrigger addTrigger;
 	dsp::SchmittTrigger delTrigger;
@@ -79,11 +83,14 @@ struct Frames : Module {
 		keyframer.Init();
 		memset(&poly_lfo, 0, sizeof(poly_lfo));
 		poly_lfo.Init();
+		lfoControlDivider.setDivision(16);
 
 		onReset();
 	}
 
 	void process(const ProcessArgs& args) override {
+		DenormalGuard denormalGuard;
+
 		// Set gain and timestamp knobs
 		uint16_t controls[4];
 		for (int i = 0; i < 4; i++) {
@@ -101,14 +108,19 @@ struct Frames : Module {
 
 		// Render, handle buttons
 		if (poly_lfo_mode) {
-			if (controls[0] != lastControls[0])
-				poly_lfo.set_shape(controls[0]);
-			if (controls[1] != lastControls[1])
-				poly_lfo.set_shape_spread(controls[1]);
-			if (controls[2] != lastControls[2])
-				poly_lfo.set_spread(controls[2]);
-			if (controls[3] != lastControls[3])
-				poly_lfo.set_coupling(controls[3]);
+			if (lfoControlDivider.process()) {
+				if (controls[0] != lfoControls[0])
+					poly_lfo.set_shape(controls[0]);
+				if (controls[1] != lfoControls[1])
+					poly_lfo.set_shape_spread(controls[1]);
+				if (controls[2] != lfoControls[2])
+					poly_lfo.set_spread(controls[2]);
+				if (controls[3] != lfoControls[3])
+					poly_lfo.set_coupling(controls[3]);
+				for (int i = 0; i < 4; i++) {
+					lfoControls[i] = controls[i];
+				}
+			}
 			poly_lfo.Render(timestampMod);
 		}
 		else {
@@ -139,24 +151,26 @@ struct Frames : Module {
 			keyframer.Evaluate(timestampMod);
 		}
 
-		// Get gains
-		float gains[4];
+		// Get gains of the four channels at once
+		simd::float_4 lin;
+		simd::float_4 response;
 		for (int i = 0; i < 4; i++) {
 			if (poly_lfo_mode) {
-				// gains[i] = poly_lfo.level(i) / 255.0;
-				gains[i] = poly_lfo.level16(i) / 65535.0;
+				// lin[i] = poly_lfo.level(i) / 255.0;
+				lin[i] = poly_lfo.level16(i);
 			}
 			else {
-				float lin = keyframer.level(i) / 65535.0;
-				gains[i] = lin;
-			}
-			// Simulate SSM2164
-			if (keyframer.mutable_settings(i)->response > 0) {
-				const float expBase = 200.0;
-				float expGain = rescale(powf(expBase, gains[i]), 1.0f, expBase, 0.0f, 1.0f);
-				gains[i] = crossfade(gains[i], expGain, keyframer.mutable_settings(i)->response / 255.0f);
+				lin[i] = keyframer.level(i);
 			}
+			response[i] = keyframer.mutable_settings(i)->response;
 		}
+		lin /= 65535.f;
+		response /= 255.f;
+		// Simulate SSM2164. A response of 0 leaves the linear gain unchanged.
+		const float expBase = 200.0;
+		simd::float_4 expGain = (simd::pow(expBase, lin) - 1.f) / (expBase - 1.f);
+		float gains[4];
+		(lin + (expGain - lin) * response).store(gains);
 
 		// Update last controls
 		for (int i = 0; i < 4; i++) {
@@ -32,6 +32,7 @@ struct Kinks : Module {
 
 	dsp::SchmittTrigger trigger;
 	float sample = 0.0;
+	RandomSource randomSource;
 
 	Kinks() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -52,8 +53,10 @@ struct Kinks : Module {
 	}
 
 	void process(const ProcessArgs& args) override {
+		randomSource.update();
+
 		// Gaussian noise generator
-		float noise = 2.0 * random::normal();
+		float noise = 2.0 * randomSource.prng.normal();
 
 		// S&H
 		if (trigger.process(inputs[TRIG_INPUT].getVoltage() / 0.7)) {
@@ -78,6 +81,16 @@ struct Kinks : Module {
 		outputs[NOISE_OUTPUT].setVoltage(noise);
 		outputs[SH_OUTPUT].setVoltage(sample);
 	}
+
+	json_t* dataToJson() override {
+		json_t* rootJ = json_object();
+		randomSource.toJson(rootJ);
+		return rootJ;
+	}
+
+	void dataFromJson(json_t* rootJ) override {
+		randomSource.fromJson(rootJ);
+	}
 };
 
 
@@ -108,6 +121,13 @@ struct KinksWidget : ModuleWidget {
 		addChild(createLight<SmallLight<GreenRedLight>>(Vec(11, 161), module, Kinks::LOGIC_POS_LIGHT));
 		addChild(createLight<SmallLight<GreenRedLight>>(Vec(11, 262), module, Kinks::SH_POS_LIGHT));
 	}
+
+	void appendContextMenu(Menu* menu) override {
+		Kinks* module = dynamic_cast<Kinks*>(this->module);
+
+		menu->addChild(new MenuSeparator);
+		appendRandomSourceMenu(menu, &module->randomSource);
+	}
 };
 
 
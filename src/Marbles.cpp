@@ -357,6 +357,8 @@ struct Marbles : Module {
 	}
 
 	void process(const ProcessArgs& args) override {
+		DenormalGuard denormalGuard;
+
 		// Buttons
 		if (tDejaVuTrigger.process(params[T_DEJA_VU_PARAM].getValue() <= 0.f)) {
 			t_deja_vu = !t_deja_vu;
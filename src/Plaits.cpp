@@ -44,14 +44,41 @@ struct Plaits : Module {
 		NUM_LIGHTS
 	};
 
+	static constexpr int blockSize = 12;
+
 	plaits::Voice voice[16];
 	plaits::Patch patch = {};
-	char shared_buffer[16][16384] = {};
+	Arena arena;
+	/** Per-voice engine memory, kept in the arena so the voices and I/O state are packed together */
+	char (*shared_buffer)[16384];
 	float triPhase = 0.f;
 
-	dsp::SampleRateConverter<16 * 2> outputSrc;
-	dsp::DoubleRingBuffer<dsp::Frame<16 * 2>, 256> outputBuffer;
-	bool lowCpu = false;
+	/** OUT of each voice */
+	PlanarSampleRateConverter<16> outputSrc;
+	/** AUX of each voice, converted apart from OUT so that it can start over when AUX is patched */
+	PlanarSampleRateConverter<16> auxSrc;
+	/** OUT of voice c in channel c, and the converted AUX of the block in channel 16 + c */
+	PlanarBlockBuffer<16 * 2, 256> outputBuffer;
+	/** AUX of each voice, read a frame at a time like outputBuffer.
+	AUX is converted apart from OUT and only while it is patched, so after a pause its converter can produce a frame more or less than OUT's in a block. Queuing it absorbs that frame.
+	*/
+	PlanarRingBuffer<16, 256> auxBuffer;
+	float auxFrame[16] = {};
+	/** Whether AUX was converted with the last block */
+	bool auxRendered = true;
+	QualityTierSetting qualityTier;
+	GovernorClient governorClient;
+	Recorder recorder;
+	/** Spread rendering as last requested, which the menu and dataToJson() show before the audio thread applies it */
+	bool spreadRender = false;
+	/** Spread rendering changes requested by the UI, applied between blocks */
+	CommandQueue<bool> spreadRenderCommands;
+	/** Renders the voices of the next block a few at a time while the current block plays, instead of all at once. Only touched by the audio thread. */
+	bool spreading = false;
+	/** Voice output at 48 kHz, OUT of voice c in rendered[c] and AUX in rendered[16 + c] */
+	float rendered[16 * 2][blockSize] = {};
+	/** Number of voices of the next block already in `rendered` */
+	int renderedVoices = 0;
 
 	dsp::BooleanTrigger model1Trigger;
 	dsp::BooleanTrigger model2Trigger;
@@ -82,6 +109,8 @@ struct Plaits : Module {
 		configOutput(OUT_OUTPUT, "Main");
 		configOutput(AUX_OUTPUT, "Auxiliary");
 
+		arena.init(Arena::sizeOf<char[16384]>(16));
+		shared_buffer = arena.alloc<char[16384]>(16);
 		for (int i = 0; i < 16; i++) {
 			stmlib::BufferAllocator allocator(shared_buffer[i], sizeof(shared_buffer[i]));
 			voice[i].Init(&allocator);
@@ -100,19 +129,29 @@ struct Plaits : Module {
 		patch.engine = random::u32() % 16;
 	}
 
+	void setSpreadRender(bool spreadRender) {
+		this->spreadRender = spreadRender;
+		spreadRenderCommands.push(spreadRender);
+	}
+
 	json_t* dataToJson() override {
 		json_t* rootJ = json_object();
 
-		json_object_set_new(rootJ, "lowCpu", json_boolean(lowCpu));
+		json_object_set_new(rootJ, "qualityTier", json_integer(qualityTier.requested));
+		// Read by versions without quality tiers
+		json_object_set_new(rootJ, "lowCpu", json_boolean(qualityTier.requested == QUALITY_ECO));
+		json_object_set_new(rootJ, "spreadRender", json_boolean(spreadRender));
 		json_object_set_new(rootJ, "model", json_integer(patch.engine));
 
 		return rootJ;
 	}
 
 	void dataFromJson(json_t* rootJ) override {
-		json_t* lowCpuJ = json_object_get(rootJ, "lowCpu");
-		if (lowCpuJ)
-			lowCpu = json_boolean_value(lowCpuJ);
+		qualityTierFromJson(rootJ, &qualityTier);
+
+		json_t* spreadRenderJ = json_object_get(rootJ, "spreadRender");
+		if (spreadRenderJ)
+			setSpreadRender(json_boolean_value(spreadRenderJ));
 
 		json_t* modelJ = json_object_get(rootJ, "model");
 		if (modelJ)
@@ -129,12 +168,63 @@ struct Plaits : Module {
 			params[LPG_DECAY_PARAM].setValue(json_number_value(decayJ));
 	}
 
+	/** Renders one block of voices `first` to `last - 1` into `rendered`. */
+	void renderVoices(int first, int last, int channels) {
+		if (first >= last)
+			return;
+
+		float cv[NUM_INPUTS][16];
+		for (int i = 0; i < NUM_INPUTS; i++) {
+			loadPolyVoltages(inputs[i], cv[i], channels);
+		}
+		for (int c = first; c < last; c++) {
+			// Construct modulations
+			plaits::Modulations modulations;
+			modulations.engine = cv[ENGINE_INPUT][c] / 5.f;
+			modulations.note = cv[NOTE_INPUT][c] * 12.f;
+			modulations.frequency = cv[FREQ_INPUT][c] * 6.f;
+			modulations.harmonics = cv[HARMONICS_INPUT][c] / 5.f;
+			modulations.timbre = cv[TIMBRE_INPUT][c] / 8.f;
+			modulations.morph = cv[MORPH_INPUT][c] / 8.f;
+			// Triggers at around 0.7 V
+			modulations.trigger = cv[TRIGGER_INPUT][c] / 3.f;
+			modulations.level = cv[LEVEL_INPUT][c] / 8.f;
+
+			modulations.frequency_patched = inputs[FREQ_INPUT].isConnected();
+			modulations.timbre_patched = inputs[TIMBRE_INPUT].isConnected();
+			modulations.morph_patched = inputs[MORPH_INPUT].isConnected();
+			modulations.trigger_patched = inputs[TRIGGER_INPUT].isConnected();
+			modulations.level_patched = inputs[LEVEL_INPUT].isConnected();
+
+			// Render frames
+			plaits::Voice::Frame output[blockSize];
+			voice[c].Render(patch, modulations, output, blockSize);
+
+			// Convert output to planar channels.
+			// AUX is always kept, since AUX may be patched by the time a voice rendered ahead is converted.
+			for (int i = 0; i < blockSize; i++) {
+				rendered[c][i] = output[i].out / 32768.f;
+				rendered[16 + c][i] = output[i].aux / 32768.f;
+			}
+		}
+	}
+
 	void process(const ProcessArgs& args) override {
+		DenormalGuard denormalGuard;
+		GovernorClient::Timer governorTimer(governorClient, args.sampleTime);
+		qualityTier.apply();
+
 		int channels = std::max(inputs[NOTE_INPUT].getChannels(), 1);
 
-		if (outputBuffer.empty()) {
-			const int blockSize = 12;
+		// Spread the next block's voices over the frames left in the current block, so no single sample renders all of them
+		if (spreading && !outputBuffer.empty() && renderedVoices < channels) {
+			int framesLeft = outputBuffer.len - outputBuffer.pos;
+			int count = (channels - renderedVoices + framesLeft - 1) / framesLeft;
+			renderVoices(renderedVoices, renderedVoices + count, channels);
+			renderedVoices += count;
+		}
 
+		if (outputBuffer.empty()) {
 			// Model buttons
 			if (model1Trigger.process(params[MODEL1_PARAM].getValue())) {
 				if (patch.engine >= 8) {
@@ -181,9 +271,12 @@ struct Plaits : Module {
 				lights[MODEL_LIGHT + lightId].setBrightness(brightness);
 			}
 
+			// Skip resampling in eco quality, or when the plugin is over its CPU budget
+			bool lowCpuActive = qualityTier.tier == QUALITY_ECO || governor.isReduced();
+
 			// Calculate pitch for lowCpu mode if needed
 			float pitch = params[FREQ_PARAM].getValue();
-			if (lowCpu)
+			if (lowCpuActive)
 				pitch += std::log2(48000.f * args.sampleTime);
 			// Update patch
 			patch.note = 60.f + pitch * 12.f;
@@ -196,65 +289,99 @@ struct Plaits : Module {
 			patch.timbre_modulation_amount = params[TIMBRE_CV_PARAM].getValue();
 			patch.morph_modulation_amount = params[MORPH_CV_PARAM].getValue();
 
-			// Render output buffer for each voice
-			dsp::Frame<16 * 2> outputFrames[blockSize];
+			// Only convert AUX when it is patched, so the SRC doesn't process it for nothing.
+			// The whole buffer is refilled at once, so this holds for every frame in it.
+			bool auxWasRendered = auxRendered;
+			auxRendered = outputs[AUX_OUTPUT].isConnected();
+			// The AUX converter still holds the samples from before AUX was unpatched, so start it from silence instead
+			if (auxRendered && !auxWasRendered)
+				auxSrc.reset();
+
+			// Render the voices that weren't rendered ahead
+			renderVoices(renderedVoices, channels, channels);
+			renderedVoices = 0;
+
+			// Applied once the voices rendered ahead are used, so switching never renders a voice twice or skips one
+			spreadRenderCommands.drain([&](bool s) {
+				spreading = s;
+				renderedVoices = 0;
+			});
+
+			float* in[16 * 2];
+			float* out[16 * 2];
 			for (int c = 0; c < channels; c++) {
-				// Construct modulations
-				plaits::Modulations modulations;
-				modulations.engine = inputs[ENGINE_INPUT].getPolyVoltage(c) / 5.f;
-				modulations.note = inputs[NOTE_INPUT].getVoltage(c) * 12.f;
-				modulations.frequency = inputs[FREQ_INPUT].getPolyVoltage(c) * 6.f;
-				modulations.harmonics = inputs[HARMONICS_INPUT].getPolyVoltage(c) / 5.f;
-				modulations.timbre = inputs[TIMBRE_INPUT].getPolyVoltage(c) / 8.f;
-				modulations.morph = inputs[MORPH_INPUT].getPolyVoltage(c) / 8.f;
-				// Triggers at around 0.7 V
-				modulations.trigger = inputs[TRIGGER_INPUT].getPolyVoltage(c) / 3.f;
-				modulations.level = inputs[LEVEL_INPUT].getPolyVoltage(c) / 8.f;
-
-				modulations.frequency_patched = inputs[FREQ_INPUT].isConnected();
-				modulations.timbre_patched = inputs[TIMBRE_INPUT].isConnected();
-				modulations.morph_patched = inputs[MORPH_INPUT].isConnected();
-				modulations.trigger_patched = inputs[TRIGGER_INPUT].isConnected();
-				modulations.level_patched = inputs[LEVEL_INPUT].isConnected();
-
-				// Render frames
-				plaits::Voice::Frame output[blockSize];
-				voice[c].Render(patch, modulations, output, blockSize);
-
-				// Convert output to frames
-				for (int i = 0; i < blockSize; i++) {
-					outputFrames[i].samples[c * 2 + 0] = output[i].out / 32768.f;
-					outputFrames[i].samples[c * 2 + 1] = output[i].aux / 32768.f;
-				}
+				in[c] = rendered[c];
+				out[c] = outputBuffer.data[c];
+				in[channels + c] = rendered[16 + c];
+				out[channels + c] = outputBuffer.data[16 + c];
 			}
 
 			// Convert output
-			if (lowCpu) {
-				int len = std::min((int) outputBuffer.capacity(), blockSize);
-				std::memcpy(outputBuffer.endData(), outputFrames, len * sizeof(outputFrames[0]));
-				outputBuffer.endIncr(len);
+			int auxLen = 0;
+			if (lowCpuActive) {
+				int len = std::min<int>(outputBuffer.capacity(), (int) blockSize);
+				int lanes = auxRendered ? 2 * channels : channels;
+				for (int l = 0; l < lanes; l++) {
+					std::memcpy(out[l], in[l], len * sizeof(float));
+				}
+				outputBuffer.fill(len);
+				auxLen = len;
 			}
 			else {
 				outputSrc.setRates(48000, (int) args.sampleRate);
+				outputSrc.setQuality(getSrcQuality(qualityTier.tier));
+				outputSrc.setChannels(channels);
 				int inLen = blockSize;
 				int outLen = outputBuffer.capacity();
-				outputSrc.setChannels(channels * 2);
-				outputSrc.process(outputFrames, &inLen, outputBuffer.endData(), &outLen);
-				outputBuffer.endIncr(outLen);
+				outputSrc.process(in, &inLen, out, &outLen);
+				outputBuffer.fill(outLen);
+				if (auxRendered) {
+					auxSrc.setRates(48000, (int) args.sampleRate);
+					auxSrc.setQuality(getSrcQuality(qualityTier.tier));
+					auxSrc.setChannels(channels);
+					inLen = blockSize;
+					auxLen = outputBuffer.capacity();
+					auxSrc.process(&in[channels], &inLen, &out[channels], &auxLen);
+				}
+			}
+
+			if (auxRendered) {
+				for (int i = 0; i < auxLen && !auxBuffer.full(); i++) {
+					for (int c = 0; c < channels; c++)
+						auxBuffer.write(c, outputBuffer.data[16 + c][i]);
+					auxBuffer.endIncr();
+				}
+			}
+			else {
+				// Drop AUX that was queued before it was unpatched
+				auxBuffer.startIncr(auxBuffer.size());
 			}
 		}
 
 		// Set output
 		if (!outputBuffer.empty()) {
-			dsp::Frame<16 * 2> outputFrame = outputBuffer.shift();
-			for (int c = 0; c < channels; c++) {
-				// Inverting op-amp on outputs
-				outputs[OUT_OUTPUT].setVoltage(-outputFrame.samples[c * 2 + 0] * 5.f, c);
-				outputs[AUX_OUTPUT].setVoltage(-outputFrame.samples[c * 2 + 1] * 5.f, c);
+			// Inverting op-amp on outputs
+			float out[16] = {};
+			for (int c = 0; c < channels; c++)
+				out[c] = -outputBuffer.get(c) * 5.f;
+			storeVoltages(outputs[OUT_OUTPUT], out, channels);
+			if (auxRendered) {
+				// If AUX is a frame behind OUT, hold its last frame
+				if (!auxBuffer.empty()) {
+					for (int c = 0; c < channels; c++)
+						auxFrame[c] = *auxBuffer.startData(c);
+					auxBuffer.startIncr(1);
+				}
+				for (int c = 0; c < channels; c++)
+					out[c] = -auxFrame[c] * 5.f;
+				storeVoltages(outputs[AUX_OUTPUT], out, channels);
 			}
+			outputBuffer.shift();
 		}
 		outputs[OUT_OUTPUT].setChannels(channels);
 		outputs[AUX_OUTPUT].setChannels(channels);
+
+		recorder.process(this, args.sampleRate);
 	}
 };
 
@@ -335,7 +462,14 @@ struct PlaitsWidget : ModuleWidget {
 
 		menu->addChild(new MenuSeparator);
 
-		menu->addChild(createBoolPtrMenuItem("Low CPU (disable resampling)", &module->lowCpu));
+		appendQualityMenu(menu, &module->qualityTier);
+		appendGovernorMenu(menu);
+		appendRecorderMenu(menu, &module->recorder, module, {Plaits::OUT_OUTPUT, Plaits::AUX_OUTPUT});
+
+		menu->addChild(createBoolMenuItem("Spread voice rendering (adds 1 block of CV latency)",
+			[=]() {return module->spreadRender;},
+			[=](bool val) {module->setSpreadRender(val);}
+		));
 
 		menu->addChild(createBoolMenuItem("Edit LPG response/decay",
 			[=]() {return this->getLpgMode();},
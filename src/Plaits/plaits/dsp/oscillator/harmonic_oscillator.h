@@ -0,0 +1,231 @@
+// Copyright 2016 Emilie Gillet.
+//
+// Author: Emilie Gillet (emilie.o.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Bank of harmonically related oscillators.
+//
+// Stands in for the firmware's harmonic oscillator, which the Makefile puts
+// behind this directory in the include path. The interface is the same, and
+// the amplitude and frequency ramps advance before use, like stmlib's
+// ParameterInterpolator. The firmware computes the partials one after the
+// other with the Chebyshev recurrence, which is a long dependency chain. Here
+// each partial is the cosine of a multiple of the master phase, so they are
+// independent and are computed 4 per float_4. The cosines are approximated and
+// the partials are summed in a different order, so the output differs from
+// the firmware's by rounding error and is not bit-exact.
+
+#ifndef PLAITS_DSP_OSCILLATOR_HARMONIC_OSCILLATOR_H_
+#define PLAITS_DSP_OSCILLATOR_HARMONIC_OSCILLATOR_H_
+
+#include <cstddef>
+#include <rack.hpp>
+
+#include "stmlib/stmlib.h"
+#include "stmlib/dsp/dsp.h"
+#include "stmlib/dsp/parameter_interpolator.h"
+
+#include "plaits/dsp/oscillator/sine_oscillator.h"
+
+namespace plaits
+{
+
+// cos(2 pi x) for x >= 0, as sin(2 pi (1/4 - |t|)) with t the distance of x
+// from the nearest integer. Odd Taylor polynomial on [-1/4, 1/4], error below
+// 1e-7.
+inline rack::simd::float_4 CosineBank(rack::simd::float_4 x)
+{
+    using rack::simd::float_4;
+
+    float_4 t = x + 0.5f;
+    t = x - rack::simd::floor(t);
+    t = 0.25f - rack::simd::fabs(t);
+
+    float_4 t2 = t * t;
+    float_4 p = -15.094642576822984f;
+    p = p * t2 + 42.058693944897634f;
+    p = p * t2 - 76.70585975306136f;
+    p = p * t2 + 81.60524927607504f;
+    p = p * t2 - 41.341702240399755f;
+    p = p * t2 + 6.283185307179586f;
+    return p * t;
+}
+
+template<int num_harmonics>
+class HarmonicOscillator
+{
+public:
+    HarmonicOscillator() { }
+    ~HarmonicOscillator() { }
+
+    void Init()
+    {
+        phase_ = 0.0f;
+        frequency_ = 0.0f;
+        for (int i = 0; i < kNumGroups; ++i)
+        {
+            amplitude_[i] = 0.0f;
+        }
+        band_limit_ = true;
+    }
+
+    // With band limiting, partials fade out as they approach Nyquist and
+    // groups of 4 that are entirely above it are skipped, as in the firmware.
+    // Without it, every partial is rendered at its full amplitude.
+    void set_band_limit(bool band_limit)
+    {
+        band_limit_ = band_limit;
+    }
+
+    template<int first_harmonic_index>
+    void Render(
+        float frequency,
+        const float* amplitudes,
+        float* out,
+        size_t size)
+    {
+        using rack::simd::float_4;
+
+        if (frequency >= 0.5f)
+        {
+            frequency = 0.5f;
+        }
+
+        // Linear ramps over the block, which start one step past the
+        // previous value, like stmlib's ParameterInterpolator
+        const float step = 1.0f / static_cast<float>(size);
+        float_4 amplitude[kNumGroups];
+        float_4 amplitude_increment[kNumGroups];
+        float_4 harmonic[kNumGroups];
+        int num_groups = 0;
+
+        for (int g = 0; g < kNumGroups; ++g)
+        {
+            float target[4];
+            for (int j = 0; j < 4; ++j)
+            {
+                int i = g * 4 + j;
+                float h = static_cast<float>(first_harmonic_index + i);
+                harmonic[g][j] = h;
+                if (i >= num_harmonics)
+                {
+                    target[j] = 0.0f;
+                    continue;
+                }
+                target[j] = amplitudes[i];
+                if (band_limit_)
+                {
+                    float f = frequency * h;
+                    if (f >= 0.5f)
+                    {
+                        f = 0.5f;
+                    }
+                    target[j] *= 1.0f - f * 2.0f;
+                }
+            }
+
+            float_4 t = float_4::load(target);
+            amplitude[g] = amplitude_[g];
+            amplitude_increment[g] = (t - amplitude_[g]) * step;
+            amplitude_[g] = t;
+
+            // Silent groups past the last sounding one are skipped. Their
+            // amplitude stays 0, so nothing needs catching up later.
+            float_4 sounding = (amplitude[g] != 0.0f) | (t != 0.0f);
+            if (rack::simd::movemask(sounding))
+            {
+                num_groups = g + 1;
+            }
+        }
+
+        float f = frequency_;
+        const float frequency_increment = (frequency - frequency_) * step;
+        frequency_ = frequency;
+
+        // Each group renders a whole chunk of samples before the next group
+        // starts, so its ramp stays in a register and the samples don't
+        // depend on each other.
+        while (size)
+        {
+            size_t chunk_size = size < kChunkSize ? size : kChunkSize;
+            float phase[kChunkSize];
+            float_4 sum[kChunkSize];
+            for (size_t n = 0; n < chunk_size; ++n)
+            {
+                f += frequency_increment;
+                phase_ += f;
+                if (phase_ >= 1.0f)
+                {
+                    phase_ -= 1.0f;
+                }
+                phase[n] = phase_;
+                sum[n] = 0.0f;
+            }
+
+            for (int g = 0; g < num_groups; ++g)
+            {
+                float_4 a = amplitude[g];
+                const float_4 a_increment = amplitude_increment[g];
+                const float_4 h = harmonic[g];
+                for (size_t n = 0; n < chunk_size; ++n)
+                {
+                    a += a_increment;
+                    // cos(2 pi h phase), like the Chebyshev recurrence
+                    sum[n] += a * CosineBank(h * phase[n]);
+                }
+                amplitude[g] = a;
+            }
+
+            for (size_t n = 0; n < chunk_size; ++n)
+            {
+                float total = sum[n][0] + sum[n][1] + sum[n][2] + sum[n][3];
+                if (first_harmonic_index == 1)
+                {
+                    *out++ = total;
+                }
+                else
+                {
+                    *out++ += total;
+                }
+            }
+            size -= chunk_size;
+        }
+    }
+
+private:
+    static const int kNumGroups = (num_harmonics + 3) / 4;
+    static const size_t kChunkSize = 16;
+
+    // Oscillator state.
+    float phase_;
+    float frequency_;
+    rack::simd::float_4 amplitude_[kNumGroups];
+    bool band_limit_;
+
+    DISALLOW_COPY_AND_ASSIGN(HarmonicOscillator);
+};
+
+}  // namespace plaits
+
+#endif  // PLAITS_DSP_OSCILLATOR_HARMONIC_OSCILLATOR_H_
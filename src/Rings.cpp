@@ -49,14 +49,26 @@ struct Rings : Module {
 	dsp::SampleRateConverter<2> outputSrc;
 	dsp::DoubleRingBuffer<dsp::Frame<1>, 256> inputBuffer;
 	dsp::DoubleRingBuffer<dsp::Frame<2>, 256> outputBuffer;
+	QualityTierSetting qualityTier;
 
-	uint16_t reverb_buffer[32768] = {};
+	Arena arena;
+	uint16_t* reverb_buffer;
 	rings::Part part;
 	rings::StringSynthPart string_synth;
 	rings::Strummer strummer;
 	bool strum = false;
 	bool lastStrum = false;
 
+	/** Change in a mod input, in volts, below which the patch is kept */
+	static constexpr float PATCH_EPSILON = 1e-3f;
+	/** Patch of the last block, which is only set again when the params or mod inputs change */
+	rings::Patch patch = {};
+	float structure = 0.f;
+	/** Mod input voltages and param values when the patch was last set */
+	float patchInputs[4] = {};
+	float patchParams[NUM_PARAMS] = {};
+	bool patchValid = false;
+
 	dsp::SchmittTrigger polyphonyTrigger;
 	dsp::SchmittTrigger modelTrigger;
 	int polyphonyMode = 0;
@@ -90,12 +102,17 @@ struct Rings : Module {
 		configOutput(ODD_OUTPUT, "Odd");
 		configOutput(EVEN_OUTPUT, "Even");
 
+		arena.init(Arena::sizeOf<uint16_t>(32768));
+		reverb_buffer = arena.alloc<uint16_t>(32768);
 		strummer.Init(0.01, 44100.0 / 24);
 		part.Init(reverb_buffer);
 		string_synth.Init(reverb_buffer);
 	}
 
 	void process(const ProcessArgs& args) override {
+		DenormalGuard denormalGuard;
+		qualityTier.apply();
+
 		// TODO
 		// "Normalized to a pulse/burst generator that reacts to note changes on the V/OCT input."
 		// Get input
@@ -129,6 +146,7 @@ struct Rings : Module {
 			// Convert input buffer
 			{
 				inputSrc.setRates(args.sampleRate, 48000);
+				inputSrc.setQuality(getSrcQuality(qualityTier.tier));
 				int inLen = inputBuffer.size();
 				int outLen = 24;
 				inputSrc.process(inputBuffer.startData(), &inLen, (dsp::Frame<1>*) in, &outLen);
@@ -146,12 +164,35 @@ struct Rings : Module {
 				part.set_model(resonatorModel);
 
 			// Patch
-			rings::Patch patch;
-			float structure = params[STRUCTURE_PARAM].getValue() + 3.3 * dsp::quadraticBipolar(params[STRUCTURE_MOD_PARAM].getValue()) * inputs[STRUCTURE_MOD_INPUT].getVoltage() / 5.0;
-			patch.structure = clamp(structure, 0.0f, 0.9995f);
-			patch.brightness = clamp(params[BRIGHTNESS_PARAM].getValue() + 3.3 * dsp::quadraticBipolar(params[BRIGHTNESS_MOD_PARAM].getValue()) * inputs[BRIGHTNESS_MOD_INPUT].getVoltage() / 5.0, 0.0f, 1.0f);
-			patch.damping = clamp(params[DAMPING_PARAM].getValue() + 3.3 * dsp::quadraticBipolar(params[DAMPING_MOD_PARAM].getValue()) * inputs[DAMPING_MOD_INPUT].getVoltage() / 5.0, 0.0f, 0.9995f);
-			patch.position = clamp(params[POSITION_PARAM].getValue() + 3.3 * dsp::quadraticBipolar(params[POSITION_MOD_PARAM].getValue()) * inputs[POSITION_MOD_INPUT].getVoltage() / 5.0, 0.0f, 0.9995f);
+			// It is only set again when a param changes or a mod input moves by more than PATCH_EPSILON.
+			// This skips the work done here, but rings::Part still recomputes the resonator's coefficients from the patch on every block.
+			float modInputs[4] = {
+				inputs[STRUCTURE_MOD_INPUT].getVoltage(),
+				inputs[BRIGHTNESS_MOD_INPUT].getVoltage(),
+				inputs[DAMPING_MOD_INPUT].getVoltage(),
+				inputs[POSITION_MOD_INPUT].getVoltage(),
+			};
+			bool patchChanged = !patchValid;
+			for (int i = 0; i < 4; i++) {
+				if (std::fabs(modInputs[i] - patchInputs[i]) > PATCH_EPSILON)
+					patchChanged = true;
+			}
+			for (int i = 0; i < NUM_PARAMS; i++) {
+				float value = params[i].getValue();
+				if (value != patchParams[i]) {
+					patchParams[i] = value;
+					patchChanged = true;
+				}
+			}
+			if (patchChanged) {
+				std::memcpy(patchInputs, modInputs, sizeof(modInputs));
+				patchValid = true;
+				structure = params[STRUCTURE_PARAM].getValue() + 3.3 * dsp::quadraticBipolar(params[STRUCTURE_MOD_PARAM].getValue()) * modInputs[0] / 5.0;
+				patch.structure = clamp(structure, 0.0f, 0.9995f);
+				patch.brightness = clamp(params[BRIGHTNESS_PARAM].getValue() + 3.3 * dsp::quadraticBipolar(params[BRIGHTNESS_MOD_PARAM].getValue()) * modInputs[1] / 5.0, 0.0f, 1.0f);
+				patch.damping = clamp(params[DAMPING_PARAM].getValue() + 3.3 * dsp::quadraticBipolar(params[DAMPING_MOD_PARAM].getValue()) * modInputs[2] / 5.0, 0.0f, 0.9995f);
+				patch.position = clamp(params[POSITION_PARAM].getValue() + 3.3 * dsp::quadraticBipolar(params[POSITION_MOD_PARAM].getValue()) * modInputs[3] / 5.0, 0.0f, 0.9995f);
+			}
 
 			// Performance
 			rings::PerformanceState performance_state;
@@ -197,6 +238,7 @@ struct Rings : Module {
 				}
 
 				outputSrc.setRates(48000, args.sampleRate);
+				outputSrc.setQuality(getSrcQuality(qualityTier.tier));
 				int inLen = 24;
 				int outLen = outputBuffer.capacity();
 				outputSrc.process(outputFrames, &inLen, outputBuffer.endData(), &outLen);
@@ -226,6 +268,7 @@ struct Rings : Module {
 		json_object_set_new(rootJ, "polyphony", json_integer(polyphonyMode));
 		json_object_set_new(rootJ, "model", json_integer((int) resonatorModel));
 		json_object_set_new(rootJ, "easterEgg", json_boolean(easterEgg));
+		json_object_set_new(rootJ, "qualityTier", json_integer(qualityTier.requested));
 
 		return rootJ;
 	}
@@ -245,6 +288,8 @@ struct Rings : Module {
 		if (easterEggJ) {
 			easterEgg = json_boolean_value(easterEggJ);
 		}
+
+		qualityTierFromJson(rootJ, &qualityTier);
 	}
 
 	void onReset() override {
@@ -330,6 +375,9 @@ struct RingsWidget : ModuleWidget {
 			[=]() {return module->easterEgg;},
 			[=](bool val) {module->easterEgg = val;}
 		));
+
+		menu->addChild(new MenuSeparator);
+		appendQualityMenu(menu, &module->qualityTier);
 	}
 };
 
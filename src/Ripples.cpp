@@ -29,6 +29,25 @@ struct Ripples : Module {
 	};
 
 	ripples::RipplesEngine engines[16];
+	/** Solver as last requested, which the menu and dataToJson() show before the audio thread applies it */
+	ripples::RipplesEngine::Solver solver = ripples::RipplesEngine::SOLVER_RK2;
+	/** Solver changes requested by the UI, applied at the next sample */
+	CommandQueue<ripples::RipplesEngine::Solver> solverCommands;
+	/** Solver selected in the menu, as applied by the audio thread */
+	ripples::RipplesEngine::Solver selectedSolver = ripples::RipplesEngine::SOLVER_RK2;
+	/** Solver the engines are using, which is implicit while the plugin is over its CPU budget */
+	ripples::RipplesEngine::Solver activeSolver = ripples::RipplesEngine::SOLVER_RK2;
+	/** Copies of the engines with the previous solver, crossfaded into the new ones after a switch */
+	ripples::RipplesEngine fadeEngines[16];
+	static constexpr int SOLVER_FADE_FRAMES = 256;
+	int fadeFrames = 0;
+	/** Number of channels copied into fadeEngines at the last switch */
+	int fadeChannels = 0;
+	/** Whether eco quality or the CPU governor forced the implicit solver at the last sample */
+	bool wasCheap = false;
+	QualityTierSetting qualityTier;
+	GovernorClient governorClient;
+	RandomSource randomSource;
 
 	Ripples() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -48,10 +67,12 @@ struct Ripples : Module {
 		configOutput(LP4VCA_OUTPUT, "Low-pass 4-pole (24 dB/oct) VCA");
 
 		onSampleRateChange();
+		randomSource.setFixedSeed(0);
 	}
 
 	void onReset() override {
 		onSampleRateChange();
+		setSolver(ripples::RipplesEngine::SOLVER_RK2);
 	}
 
 	void onSampleRateChange() override {
@@ -59,11 +80,46 @@ struct Ripples : Module {
 		for (int c = 0; c < 16; c++) {
 			engines[c].setSampleRate(APP->engine->getSampleRate());
 		}
+		fadeFrames = 0;
 	}
 
 	void process(const ProcessArgs& args) override {
+		DenormalGuard denormalGuard;
+		GovernorClient::Timer governorTimer(governorClient, args.sampleTime);
+		qualityTier.apply();
+
+		solverCommands.drain([&](ripples::RipplesEngine::Solver s) {
+			selectedSolver = s;
+		});
+		if (randomSource.update()) {
+			// Give each engine its own noise sequence
+			for (int c = 0; c < 16; c++) {
+				uint64_t seed = randomSource.prng.u32();
+				seed = (seed << 32) | randomSource.prng.u32();
+				engines[c].seed(seed);
+			}
+		}
+		// Eco quality and the CPU governor use the cheaper implicit solver
+		bool cheap = qualityTier.tier == QUALITY_ECO || governor.isReduced();
+		ripples::RipplesEngine::Solver targetSolver = cheap ? ripples::RipplesEngine::SOLVER_IMPLICIT : selectedSolver;
 		int channels = std::max(inputs[IN_INPUT].getChannels(), 1);
 
+		if (targetSolver != activeSolver) {
+			activeSolver = targetSolver;
+			// The engines keep their filter state across the switch.
+			// When the switch comes from the menu, the old solver keeps running briefly to hide the change in response.
+			// Switches forced by eco quality or the governor are immediate, since they happen when CPU is short.
+			bool fade = (cheap == wasCheap);
+			for (int c = 0; c < channels; c++) {
+				if (fade)
+					fadeEngines[c] = engines[c];
+				engines[c].setSolver(activeSolver);
+			}
+			fadeFrames = fade ? SOLVER_FADE_FRAMES : 0;
+			fadeChannels = channels;
+		}
+		wasCheap = cheap;
+
 		// Reuse the same frame object for multiple engines because the params aren't touched.
 		ripples::RipplesEngine::Frame frame;
 		frame.res_knob = params[RES_PARAM].getValue();
@@ -71,26 +127,79 @@ struct Ripples : Module {
 		frame.fm_knob = params[FM_PARAM].getValue();
 		frame.gain_cv_present = inputs[GAIN_INPUT].isConnected();
 
+		// Move port voltages in bulk, so the engine loop only touches plain arrays
+		float resCv[16], freqCv[16], fmCv[16], in[16], gainCv[16];
+		loadPolyVoltages(inputs[RES_INPUT], resCv, channels);
+		loadPolyVoltages(inputs[FREQ_INPUT], freqCv, channels);
+		loadPolyVoltages(inputs[FM_INPUT], fmCv, channels);
+		loadPolyVoltages(inputs[IN_INPUT], in, channels);
+		loadPolyVoltages(inputs[GAIN_INPUT], gainCv, channels);
+		float bp2[16] = {}, lp2[16] = {}, lp4[16] = {}, lp4vca[16] = {};
+
 		for (int c = 0; c < channels; c++) {
-			frame.res_cv = inputs[RES_INPUT].getPolyVoltage(c);
-			frame.freq_cv = inputs[FREQ_INPUT].getPolyVoltage(c);
-			frame.fm_cv = inputs[FM_INPUT].getPolyVoltage(c);
-			frame.input = inputs[IN_INPUT].getVoltage(c);
-			frame.gain_cv = inputs[GAIN_INPUT].getPolyVoltage(c);
+			frame.res_cv = resCv[c];
+			frame.freq_cv = freqCv[c];
+			frame.fm_cv = fmCv[c];
+			frame.input = in[c];
+			frame.gain_cv = gainCv[c];
+
+			// Inactive channels switch solvers when they are next used
+			if (engines[c].getSolver() != activeSolver)
+				engines[c].setSolver(activeSolver);
 
+			ripples::RipplesEngine::Frame fadeFrame = frame;
 			engines[c].process(frame);
 
-			outputs[BP2_OUTPUT].setVoltage(frame.bp2, c);
-			outputs[LP2_OUTPUT].setVoltage(frame.lp2, c);
-			outputs[LP4_OUTPUT].setVoltage(frame.lp4, c);
-			outputs[LP4VCA_OUTPUT].setVoltage(frame.lp4vca, c);
+			bp2[c] = frame.bp2;
+			lp2[c] = frame.lp2;
+			lp4[c] = frame.lp4;
+			lp4vca[c] = frame.lp4vca;
+
+			if (fadeFrames > 0 && c < fadeChannels) {
+				fadeEngines[c].process(fadeFrame);
+				float fade = (float) fadeFrames / SOLVER_FADE_FRAMES;
+				bp2[c] += fade * (fadeFrame.bp2 - bp2[c]);
+				lp2[c] += fade * (fadeFrame.lp2 - lp2[c]);
+				lp4[c] += fade * (fadeFrame.lp4 - lp4[c]);
+				lp4vca[c] += fade * (fadeFrame.lp4vca - lp4vca[c]);
+			}
 		}
+		if (fadeFrames > 0)
+			fadeFrames--;
+
+		storeVoltages(outputs[BP2_OUTPUT], bp2, channels);
+		storeVoltages(outputs[LP2_OUTPUT], lp2, channels);
+		storeVoltages(outputs[LP4_OUTPUT], lp4, channels);
+		storeVoltages(outputs[LP4VCA_OUTPUT], lp4vca, channels);
 
 		outputs[BP2_OUTPUT].setChannels(channels);
 		outputs[LP2_OUTPUT].setChannels(channels);
 		outputs[LP4_OUTPUT].setChannels(channels);
 		outputs[LP4VCA_OUTPUT].setChannels(channels);
 	}
+
+	void setSolver(ripples::RipplesEngine::Solver solver) {
+		this->solver = solver;
+		solverCommands.push(solver);
+	}
+
+	json_t* dataToJson() override {
+		json_t* rootJ = json_object();
+		json_object_set_new(rootJ, "solver", json_integer(solver));
+		json_object_set_new(rootJ, "qualityTier", json_integer(qualityTier.requested));
+		randomSource.toJson(rootJ);
+		return rootJ;
+	}
+
+	void dataFromJson(json_t* rootJ) override {
+		json_t* solverJ = json_object_get(rootJ, "solver");
+		if (solverJ) {
+			setSolver((ripples::RipplesEngine::Solver) json_integer_value(solverJ));
+		}
+
+		qualityTierFromJson(rootJ, &qualityTier);
+		randomSource.fromJson(rootJ);
+	}
 };
 
 
@@ -117,6 +226,30 @@ struct RipplesWidget : ModuleWidget {
 		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(20.297, 111.05)), module, Ripples::LP4_OUTPUT));
 		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(32.367, 111.05)), module, Ripples::LP4VCA_OUTPUT));
 	}
+
+	void appendContextMenu(Menu* menu) override {
+		Ripples* module = dynamic_cast<Ripples*>(this->module);
+		assert(module);
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createMenuLabel("Filter solver"));
+
+		static const std::vector<std::string> solverLabels = {
+			"Runge-Kutta (reference)",
+			"Implicit (lower CPU)",
+		};
+		for (int i = 0; i < (int) solverLabels.size(); i++) {
+			menu->addChild(createCheckMenuItem(solverLabels[i],
+				[=]() {return module->solver == i;},
+				[=]() {module->setSolver((ripples::RipplesEngine::Solver) i);}
+			));
+		}
+
+		menu->addChild(new MenuSeparator);
+		appendQualityMenu(menu, &module->qualityTier);
+		appendGovernorMenu(menu);
+		appendRandomSourceMenu(menu, &module->randomSource);
+	}
 };
 
 
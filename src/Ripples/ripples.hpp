@@ -18,7 +18,9 @@
 #include <algorithm>
 #include <random>
 #include "rack.hpp"
+#include "../prng.hpp"
 #include "aafilter.hpp"
+#include "../Streams/aafilter.hpp"
 
 using namespace rack;
 
@@ -111,6 +113,17 @@ static const float kVtoICollectorVSat = -10.f;
 // Opamp saturation voltage
 static const float kOpampSatV = 10.6f;
 
+// Implicit solver
+// Above this prewarped cutoff (in radians per oversampled period, about
+// 4.6kHz at 96kHz), a second Newton iteration corrects the pitch of
+// self-oscillation, which one iteration flattens by up to 35 cents at 14kHz
+static const float kImplicitNewtonWarp = 0.15f;
+static const int kImplicitMaxIterations = 2;
+
+// Host-rate frames used to settle the resampling filters after a solver
+// switch
+static const int kSolverSwitchPrimeFrames = 128;
+
 
 class RipplesEngine
 {
@@ -137,31 +150,96 @@ public:
         float lp4vca;
     };
 
+    enum Solver
+    {
+        // Explicit 2nd order Runge-Kutta, oversampled to at least 120kHz
+        SOLVER_RK2,
+        // Trapezoidal with one or two Newton iterations, oversampled to at
+        // least 80kHz
+        SOLVER_IMPLICIT,
+    };
+
     RipplesEngine()
     {
+        solver_ = SOLVER_RK2;
         setSampleRate(1.f);
     }
 
     void setSampleRate(float sample_rate)
     {
+        sample_rate_ = sample_rate;
         sample_time_ = 1.f / sample_rate;
         cell_voltage_ = 0.f;
+        last_inputs_ = 0.f;
+        last_outputs_ = 0.f;
 
         aa_filter_.Init(sample_rate);
+        implicit_up_filter_.Init(sample_rate);
+        implicit_down_filter_.Init(sample_rate);
 
-        float oversample_rate =
-            sample_rate * aa_filter_.GetOversamplingFactor();
+        SetOversampleRate();
+    }
 
-        float freq_cut = 1.f / (2.f * M_PI * kFreqAmpR * kFreqAmpC);
-        float res_cut  = 1.f / (2.f * M_PI * kResAmpR  * kResAmpC);
-        float gain_cut = 1.f / (2.f * M_PI * kGainAmpR * kGainAmpC);
-        float ff_cut = 1.f / (2.f * M_PI * kFeedforwardR * kFeedforwardC);
+    // Switching solvers changes the oversampling factor. The filter core and
+    // the control filters keep their state, and the new resampling filters
+    // are settled on the last frame, so the switch doesn't click.
+    void setSolver(Solver solver)
+    {
+        if (solver == solver_)
+        {
+            return;
+        }
 
-        auto cutoffs = simd::float_4(ff_cut, freq_cut, res_cut, gain_cut);
-        rc_filters_.setCutoffFreq(cutoffs / oversample_rate);
+        solver_ = solver;
+        SetOversampleRate();
 
-        float vca_cut = 1.f / (2.f * M_PI * kVCAInputR * kVCAInputC);
-        vca_hpf_.setCutoffFreq(vca_cut / oversample_rate);
+        int oversampling_factor = GetOversamplingFactor();
+        simd::float_4 inputs = last_inputs_ * oversampling_factor;
+        if (solver_ == SOLVER_IMPLICIT)
+        {
+            implicit_up_filter_.Init(sample_rate_);
+            implicit_down_filter_.Init(sample_rate_);
+        }
+        else
+        {
+            aa_filter_.Init(sample_rate_);
+        }
+
+        for (int n = 0; n < kSolverSwitchPrimeFrames; n++)
+        {
+            for (int i = 0; i < oversampling_factor; i++)
+            {
+                simd::float_4 in = (i == 0) ? inputs : 0.f;
+                if (solver_ == SOLVER_IMPLICIT)
+                {
+                    implicit_up_filter_.Process(in);
+                    implicit_down_filter_.Process(last_outputs_);
+                }
+                else
+                {
+                    aa_filter_.ProcessUp(in);
+                    aa_filter_.ProcessDown(last_outputs_);
+                }
+            }
+        }
+    }
+
+    Solver getSolver(void)
+    {
+        return solver_;
+    }
+
+    // Seeds the noise that bootstraps self-oscillation
+    void seed(uint64_t seed)
+    {
+        noise_.seed(seed);
+    }
+
+    int GetOversamplingFactor(void)
+    {
+        return (solver_ == SOLVER_IMPLICIT) ?
+            streams::OversamplingFactor(sample_rate_) :
+            aa_filter_.GetOversamplingFactor();
     }
 
     void process(Frame& frame)
@@ -188,21 +266,35 @@ public:
         float i_vca = VtoIConverter(kGainAmpR, gain_cv, gain_input_r);
 
         // Pack and upsample inputs
-        int oversampling_factor = aa_filter_.GetOversamplingFactor();
+        int oversampling_factor = GetOversamplingFactor();
         float timestep = sample_time_ / oversampling_factor;
         // Add noise to input to bootstrap self-oscillation
-        float input = frame.input + 1e-6 * (random::uniform() - 0.5f);
+        float input = frame.input + 1e-6 * (noise_.uniform() - 0.5f);
         auto inputs = simd::float_4(input, v_oct, i_reso, i_vca);
+        last_inputs_ = inputs;
         inputs *= oversampling_factor;
         simd::float_4 outputs;
 
-        for (int i = 0; i < oversampling_factor; i++)
+        if (solver_ == SOLVER_IMPLICIT)
         {
-            inputs = aa_filter_.ProcessUp((i == 0) ? inputs : 0.f);
-            outputs = CoreProcess(inputs, timestep);
-            outputs = aa_filter_.ProcessDown(outputs);
+            for (int i = 0; i < oversampling_factor; i++)
+            {
+                inputs = implicit_up_filter_.Process((i == 0) ? inputs : 0.f);
+                outputs = CoreProcess(inputs, timestep);
+                outputs = implicit_down_filter_.Process(outputs);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < oversampling_factor; i++)
+            {
+                inputs = aa_filter_.ProcessUp((i == 0) ? inputs : 0.f);
+                outputs = CoreProcess(inputs, timestep);
+                outputs = aa_filter_.ProcessDown(outputs);
+            }
         }
 
+        last_outputs_ = outputs;
         frame.bp2    = outputs[0];
         frame.lp2    = outputs[1];
         frame.lp4    = outputs[2];
@@ -212,9 +304,37 @@ public:
 protected:
     float sample_time_;
     simd::float_4 cell_voltage_;
+    // Last host-rate inputs and outputs, to settle the resampling filters
+    // when switching solvers
+    simd::float_4 last_inputs_;
+    simd::float_4 last_outputs_;
     ripples::AAFilter<simd::float_4> aa_filter_;
+    // The implicit solver is stable at a lower rate, so it borrows the
+    // Streams filters, which oversample to 80kHz rather than 120kHz
+    streams::UpsamplingAAFilter<simd::float_4> implicit_up_filter_;
+    streams::DownsamplingAAFilter<simd::float_4> implicit_down_filter_;
     dsp::TRCFilter<simd::float_4> rc_filters_;
     dsp::TRCFilter<float> vca_hpf_;
+    float sample_rate_;
+    Solver solver_;
+    Prng noise_;
+
+    // Tunes the filters that run at the oversampled rate, keeping their state
+    void SetOversampleRate(void)
+    {
+        float oversample_rate = sample_rate_ * GetOversamplingFactor();
+
+        float freq_cut = 1.f / (2.f * M_PI * kFreqAmpR * kFreqAmpC);
+        float res_cut  = 1.f / (2.f * M_PI * kResAmpR  * kResAmpC);
+        float gain_cut = 1.f / (2.f * M_PI * kGainAmpR * kGainAmpC);
+        float ff_cut = 1.f / (2.f * M_PI * kFeedforwardR * kFeedforwardC);
+
+        auto cutoffs = simd::float_4(ff_cut, freq_cut, res_cut, gain_cut);
+        rc_filters_.setCutoffFreq(cutoffs / oversample_rate);
+
+        float vca_cut = 1.f / (2.f * M_PI * kVCAInputR * kVCAInputC);
+        vca_hpf_.setCutoffFreq(vca_cut / oversample_rate);
+    }
 
     // High-rate processing core
     // inputs: vector containing (input, v_oct, i_reso, i_vca)
@@ -253,8 +373,9 @@ protected:
         // Calculate -A / RC
         simd::float_4 rad_per_s = -std::exp2f(v_oct) / kFilterCellRC;
 
-        // Emulate the filter core
-        cell_voltage_ = StepRK2(timestep, cell_voltage_, [&](simd::float_4 vout)
+        // The core input is the filter input plus the resonance signal
+        float vp = feedforward * kFeedforwardGain;
+        auto cell_sum = [&](simd::float_4 vout)
         {
             // vout contains the initial cell voltages (v0, v1 v2, v3)
 
@@ -262,8 +383,6 @@ protected:
             simd::float_4 vin =
                 _mm_shuffle_ps(vout.v, vout.v, _MM_SHUFFLE(2, 1, 0, 3));
 
-            // The core input is the filter input plus the resonance signal
-            float vp = feedforward * kFeedforwardGain;
             float vn = vout[3] * kFeedbackGain;
             float res = kFilterCellR * OTAVCA(vp, vn, i_reso);
             simd::float_4 in = inputs[0] * kFilterInputGain + res;
@@ -274,16 +393,32 @@ protected:
             // Now, vin contains (in, v0, v1, v2)
             // and vout contains (v0, v1, v2, v3)
             // Their sum gives us vin + vout for each cell
-            simd::float_4 vsum = vin + vout;
-            simd::float_4 dvout = rad_per_s * vsum;
+            return vin + vout;
+        };
 
-            // Generate some even-order harmonics via self-modulation
-            dvout *= (1.f + vsum * kFilterCellSelfModulation);
+        // Emulate the filter core
+        if (solver_ == SOLVER_IMPLICIT)
+        {
+            cell_voltage_ = StepImplicit(timestep, cell_voltage_,
+                rad_per_s[0], vp, i_reso, cell_sum);
+        }
+        else
+        {
+            cell_voltage_ = StepRK2(timestep, cell_voltage_,
+                [&](simd::float_4 vout)
+            {
+                simd::float_4 vsum = cell_sum(vout);
+                simd::float_4 dvout = rad_per_s * vsum;
+
+                // Generate some even-order harmonics via self-modulation
+                dvout *= (1.f + vsum * kFilterCellSelfModulation);
 
-            return dvout;
-        });
+                return dvout;
+            });
+        }
 
         cell_voltage_ = simd::clamp(cell_voltage_, -kOpampSatV, kOpampSatV);
+        cell_voltage_ = flushDenormal(cell_voltage_);
 
         float lp1 = cell_voltage_[0];
         float lp2 = cell_voltage_[1];
@@ -306,6 +441,84 @@ protected:
         return y + dt * k2;
     }
 
+    // Solves the filter core ODE with the trapezoidal rule, using Newton
+    // iterations that start from the current state. The first iteration is
+    // a linearly implicit step: it is exact for the linear part of the core,
+    // and stays stable at high cutoffs and resonance where RK2 needs a higher
+    // rate. At high cutoffs, a second iteration corrects for the core's
+    // nonlinearity.
+    //
+    // With f(v) = rad * u * (1 + s*u) and u = cell_sum(v), each iteration
+    // refines the next state x, starting from v, by solving
+    //   (I - h/2 J(v)) dx = v - x + h/2 (f(v) + f(x))
+    // where J is the Jacobian of f. Each cell depends only on itself and the
+    // cell before it, and the first cell also depends on the last through
+    // the resonance path, so J is lower bidiagonal plus one corner term and
+    // the system can be solved directly.
+    template <typename F>
+    simd::float_4 StepImplicit(float dt, simd::float_4 v, float rad,
+        float vp, float i_reso, F cell_sum)
+    {
+        // Prewarp the cutoff so the linear response matches the analog core
+        const float kMaxWarp = 1.5f;
+        float warp = std::min(-rad * dt / 2.f, kMaxWarp);
+        rad = -2.f / dt * std::tan(warp);
+
+        int iterations =
+            (warp > kImplicitNewtonWarp) ? kImplicitMaxIterations : 1;
+
+        // The Jacobian is evaluated once, at the current state, and reused
+        // by the second iteration
+        simd::float_4 vsum = cell_sum(v);
+        simd::float_4 f0 = rad * vsum *
+            (1.f + vsum * kFilterCellSelfModulation);
+        simd::float_4 ad = dt / 2.f * rad *
+            (1.f + vsum * (2.f * kFilterCellSelfModulation));
+
+        // Derivative of the core input with respect to the last cell
+        float g = -kFilterCellR * kFeedbackGain *
+            OTAVCAGain(vp, v[3] * kFeedbackGain, i_reso);
+
+        // Forward substitution, leaving dx[0] free:
+        // dx[k] = p[k] + q[k] dx[0]
+        float r[4];
+        float q[4] = {1.f};
+        for (int k = 1; k < 4; k++)
+        {
+            r[k] = 1.f / (1.f - ad[k]);
+            q[k] = ad[k] * q[k - 1] * r[k];
+        }
+        // Closes the loop through the resonance path
+        float r0 = 1.f / (1.f - ad[0] - ad[0] * g * q[3]);
+
+        simd::float_4 x = v;
+        simd::float_4 b = dt * f0;
+        for (int i = 0; i < iterations; i++)
+        {
+            if (i > 0)
+            {
+                vsum = cell_sum(x);
+                simd::float_4 fx = rad * vsum *
+                    (1.f + vsum * kFilterCellSelfModulation);
+                b = v - x + dt / 2.f * (f0 + fx);
+            }
+
+            float p[4] = {0.f};
+            for (int k = 1; k < 4; k++)
+            {
+                p[k] = (b[k] + ad[k] * p[k - 1]) * r[k];
+            }
+            float dx0 = (b[0] + ad[0] * g * p[3]) * r0;
+
+            for (int k = 0; k < 4; k++)
+            {
+                x[k] += p[k] + q[k] * dx0;
+            }
+        }
+
+        return x;
+    }
+
     // Model of Ripples nonlinear CV voltage-to-current converters
     float VtoIConverter(
         float rfb,                          // Amplifier feedback resistor
@@ -363,6 +576,29 @@ protected:
 
         return i_abc * p;
     }
+
+    // Derivative of OTAVCA() with respect to its differential input voltage
+    float OTAVCAGain(float vp, float vn, float i_abc)
+    {
+        const float kTemperature = 40.f; // Silicon temperature in Celsius
+        const float kKoverQ = 8.617333262145e-5;
+        const float kKelvin = 273.15f; // 0C in K
+        const float kVt = kKoverQ * (kTemperature + kKelvin);
+        const float kZlim = 2.f * std::sqrt(3.f);
+
+        float z = math::clamp((vp - vn) / (2 * kVt), -kZlim, kZlim);
+
+        // Derivative of the Pade approximant, which reaches zero at the
+        // clipping point
+        float z2 = z * z;
+        float n = 12.f * z * (12.f + z2);
+        float dn = 144.f + 36.f * z2;
+        float d = z2 * z2 + 60.f * z2 + 144.f;
+        float dd = 4.f * z * z2 + 120.f * z;
+        float dp = (dn * d - n * dd) / (d * d);
+
+        return i_abc * dp / (2 * kVt);
+    }
 };
 
 }
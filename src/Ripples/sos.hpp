@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include "../denormal.hpp"
+
 namespace ripples
 {
 
@@ -83,10 +85,12 @@ public:
     {
         for (int n = 0; n < num_sections_; n++)
         {
-            // Shift x state
+            // Shift x state. Each section's input is the previous section's
+            // output, so flushing it here keeps the whole cascade's recursive
+            // state out of the denormal range.
             x_[n][2] = x_[n][1];
             x_[n][1] = x_[n][0];
-            x_[n][0] = in;
+            x_[n][0] = flushDenormal(in);
 
             T out = 0.f;
 
@@ -104,7 +108,7 @@ public:
         // Shift final section x state
         x_[num_sections_][2] = x_[num_sections_][1];
         x_[num_sections_][1] = x_[num_sections_][0];
-        x_[num_sections_][0] = in;
+        x_[num_sections_][0] = flushDenormal(in);
 
         return in;
     }
@@ -114,6 +114,8 @@ struct Shelves : Module {
 	}
 
 	void process(const ProcessArgs& args) override {
+		DenormalGuard denormalGuard;
+
 		int channels = std::max(inputs[IN_INPUT].getChannels(), 1);
 
 		// Reuse the same frame object for multiple engines because the params aren't touched.
@@ -155,33 +157,44 @@ struct Shelves : Module {
 
 		float clipLight = 0.f;
 
+		// Move port voltages in bulk, so the engine loop only touches plain arrays
+		float in[NUM_INPUTS][16];
+		for (int i = 0; i < NUM_INPUTS; i++) {
+			loadPolyVoltages(inputs[i], in[i], channels);
+		}
+		float out[NUM_OUTPUTS][16] = {};
+
 		for (int c = 0; c < channels; c++) {
-			frame.main_in = inputs[IN_INPUT].getVoltage(c);
-			frame.hs_freq_cv = inputs[HS_FREQ_INPUT].getPolyVoltage(c);
-			frame.hs_gain_cv = inputs[HS_GAIN_INPUT].getPolyVoltage(c);
-			frame.p1_freq_cv = inputs[P1_FREQ_INPUT].getPolyVoltage(c);
-			frame.p1_gain_cv = inputs[P1_GAIN_INPUT].getPolyVoltage(c);
-			frame.p1_q_cv = inputs[P1_Q_INPUT].getPolyVoltage(c);
-			frame.p2_freq_cv = inputs[P2_FREQ_INPUT].getPolyVoltage(c);
-			frame.p2_gain_cv = inputs[P2_GAIN_INPUT].getPolyVoltage(c);
-			frame.p2_q_cv = inputs[P2_Q_INPUT].getPolyVoltage(c);
-			frame.ls_freq_cv = inputs[LS_FREQ_INPUT].getPolyVoltage(c);
-			frame.ls_gain_cv = inputs[LS_GAIN_INPUT].getPolyVoltage(c);
-			frame.global_freq_cv = inputs[FREQ_INPUT].getPolyVoltage(c);
-			frame.global_gain_cv = inputs[GAIN_INPUT].getPolyVoltage(c);
+			frame.main_in = in[IN_INPUT][c];
+			frame.hs_freq_cv = in[HS_FREQ_INPUT][c];
+			frame.hs_gain_cv = in[HS_GAIN_INPUT][c];
+			frame.p1_freq_cv = in[P1_FREQ_INPUT][c];
+			frame.p1_gain_cv = in[P1_GAIN_INPUT][c];
+			frame.p1_q_cv = in[P1_Q_INPUT][c];
+			frame.p2_freq_cv = in[P2_FREQ_INPUT][c];
+			frame.p2_gain_cv = in[P2_GAIN_INPUT][c];
+			frame.p2_q_cv = in[P2_Q_INPUT][c];
+			frame.ls_freq_cv = in[LS_FREQ_INPUT][c];
+			frame.ls_gain_cv = in[LS_GAIN_INPUT][c];
+			frame.global_freq_cv = in[FREQ_INPUT][c];
+			frame.global_gain_cv = in[GAIN_INPUT][c];
 
 			engines[c].process(frame);
 
-			outputs[P1_HP_OUTPUT].setVoltage(frame.p1_hp_out, c);
-			outputs[P1_BP_OUTPUT].setVoltage(frame.p1_bp_out, c);
-			outputs[P1_LP_OUTPUT].setVoltage(frame.p1_lp_out, c);
-			outputs[P2_HP_OUTPUT].setVoltage(frame.p2_hp_out, c);
-			outputs[P2_BP_OUTPUT].setVoltage(frame.p2_bp_out, c);
-			outputs[P2_LP_OUTPUT].setVoltage(frame.p2_lp_out, c);
-			outputs[OUT_OUTPUT].setVoltage(frame.main_out, c);
+			out[P1_HP_OUTPUT][c] = frame.p1_hp_out;
+			out[P1_BP_OUTPUT][c] = frame.p1_bp_out;
+			out[P1_LP_OUTPUT][c] = frame.p1_lp_out;
+			out[P2_HP_OUTPUT][c] = frame.p2_hp_out;
+			out[P2_BP_OUTPUT][c] = frame.p2_bp_out;
+			out[P2_LP_OUTPUT][c] = frame.p2_lp_out;
+			out[OUT_OUTPUT][c] = frame.main_out;
 			clipLight += frame.clip;
 		}
 
+		for (int i = 0; i < NUM_OUTPUTS; i++) {
+			storeVoltages(outputs[i], out[i], channels);
+		}
+
 		outputs[P1_HP_OUTPUT].setChannels(channels);
 		outputs[P1_BP_OUTPUT].setChannels(channels);
 		outputs[P1_LP_OUTPUT].setChannels(channels);
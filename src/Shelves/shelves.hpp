@@ -105,104 +105,89 @@ inline void StepRK2(float dt, T y[], F f)
     }
 }
 
-template <typename T>
-class LPFilter
+// The four filter sections, packed into one vector per integrator.
+// Lanes 0 and 3 are the low and high shelf one-pole lowpass filters, and
+// lanes 1 and 2 are the two peaking state-variable filters. The first
+// register holds the one-pole outputs and the SVF lowpass integrators, and
+// the second holds the SVF bandpass integrators, which stay at zero in the
+// one-pole lanes. Each lane does the same arithmetic as a separate filter.
+class FilterBank
 {
 public:
     void Init(void)
     {
-        voltage_ = 0.f;
-    }
-
-    T Process(float timestep, T v_in, T vca_level)
-    {
-        T rad_per_s = -vca_level / kFilterRC;
-
-        voltage_ = StepRK2(timestep, voltage_, [&](T v_state)
-        {
-            return rad_per_s * (v_in + v_state);
-        });
-
-        voltage_ = simd::clamp(voltage_, -kClampVoltage, kClampVoltage);
-        return voltage_;
-    }
-
-    T voltage(void)
-    {
-        return voltage_;
-    }
-
-protected:
-    T voltage_;
-};
-
-template <typename T>
-class SVFilter
-{
-public:
-    void Init(void)
-    {
-        bp_ = 0.f;
-        lp_ = 0.f;
+        voltage_[0] = 0.f;
+        voltage_[1] = 0.f;
+        out_ = 0.f;
         hp_ = 0.f;
+        one_pole_mask_ = simd::float_4(1.f, 0.f, 0.f, 1.f) > 0.f;
     }
 
-    T Process(float timestep, T in, T vca_level, T q_level)
+    void Process(float timestep, simd::float_4 in,
+        simd::float_4 vca_level, simd::float_4 q_level)
     {
+        // For the one-pole lowpass integrators,
+        //   dv/dt = -A/RC * (in + v)
+        //
         // Thanks Émilie!
         // https://mutable-instruments.net/archive/documents/svf_analysis.pdf
         //
-        // For the bandpass integrator,
+        // For the SVF bandpass integrator,
         //   dv/dt = -A/RC * hp
-        // For the lowpass integrator,
+        // For the SVF lowpass integrator,
         //   dv/dt = -A/RC * bp
         // with
         //   hp = -(in + lp - 2*Q*bp)
 
-        T rad_per_s = -vca_level / kFilterRC;
+        simd::float_4 rad_per_s = -vca_level / kFilterRC;
 
-        StepRK2<2>(timestep, voltage_, [&](const T v_state[], T v_stepped[])
+        StepRK2<2>(timestep, voltage_,
+            [&](const simd::float_4 v_state[], simd::float_4 v_stepped[])
         {
-            T lp = v_state[0];
-            T bp = v_state[1];
-            T hp = -(in + lp - 2.f * q_level * bp);
-            v_stepped[0] = rad_per_s * bp;
-            v_stepped[1] = rad_per_s * hp;
+            simd::float_4 lp = v_state[0];
+            simd::float_4 bp = v_state[1];
+            simd::float_4 hp = -(in + lp - 2.f * q_level * bp);
+            v_stepped[0] = rad_per_s * simd::ifelse(one_pole_mask_, in + lp, bp);
+            v_stepped[1] = simd::ifelse(one_pole_mask_, 0.f, rad_per_s * hp);
         });
 
-        lp_ = simd::clamp(lp_, -kClampVoltage, kClampVoltage);
-        bp_ = simd::clamp(bp_, -kClampVoltage, kClampVoltage);
-        T out = bp() * -2.f * q_level;
-        hp_ = -(in + lp() + out);
-        return out;
+        voltage_[0] = simd::clamp(voltage_[0], -kClampVoltage, kClampVoltage);
+        voltage_[1] = simd::clamp(voltage_[1], -kClampVoltage, kClampVoltage);
+        voltage_[0] = flushDenormal(voltage_[0]);
+        voltage_[1] = flushDenormal(voltage_[1]);
+        out_ = bp() * -2.f * q_level;
+        hp_ = -(in + lp() + out_);
     }
 
-    T hp(void)
+    // One-pole outputs in lanes 0 and 3, SVF lowpass outputs in lanes 1 and 2
+    simd::float_4 lp(void)
     {
-        return hp_;
+        return voltage_[0];
     }
 
-    T bp(void)
+    // SVF bandpass outputs in lanes 1 and 2
+    simd::float_4 bp(void)
     {
-        return bp_;
+        return voltage_[1];
     }
 
-    T lp(void)
+    // SVF highpass outputs in lanes 1 and 2
+    simd::float_4 hp(void)
     {
-        return lp_;
+        return hp_;
     }
 
-protected:
-    union
+    // Peaking filter outputs in lanes 1 and 2
+    simd::float_4 out(void)
     {
-        T voltage_[2];
-        struct
-        {
-            T lp_;
-            T bp_;
-        };
-    };
-    T hp_;
+        return out_;
+    }
+
+protected:
+    simd::float_4 voltage_[2];
+    simd::float_4 out_;
+    simd::float_4 hp_;
+    simd::float_4 one_pole_mask_;
 };
 
 class ShelvesEngine
@@ -289,8 +274,7 @@ public:
         down_filter_[0].Init(sample_rate);
         down_filter_[1].Init(sample_rate);
 
-        low_high_.Init();
-        mid_.Init();
+        filters_.Init();
 
         float freq_cut = 1.f / (2.f * M_PI * kFreqAmpR * kFreqAmpC);
         freq_lpf_.reset();
@@ -449,10 +433,10 @@ public:
                 _mm_shuffle_ps(q_cv.v, q_cv.v, _MM_SHUFFLE(0, 0, 0, 0));
 
             // Process VCFs
-            low_high_.Process(timestep, in, f_level);
-            float low = low_high_.voltage()[0];
-            float high = low_high_.voltage()[3];
-            simd::float_4 mid = mid_.Process(timestep, in, f_level, q_level);
+            filters_.Process(timestep, in, f_level, q_level);
+            float low = filters_.lp()[0];
+            float high = filters_.lp()[3];
+            simd::float_4 mid = filters_.out();
 
             // Calculate output
             low *= 1.f - gain_level[0];
@@ -460,7 +444,7 @@ public:
             high = -high + (high + in[0]) * gain_level[3];
             float sum = 2.f * (low + mid[1] + mid[2] + high);
 
-            out1 = simd::float_4(sum, mid_.lp()[1], mid_.bp()[1], mid_.hp()[1]);
+            out1 = simd::float_4(sum, filters_.lp()[1], filters_.bp()[1], filters_.hp()[1]);
             out1 = simd::clamp(out1, -kClampVoltage, kClampVoltage);
 
             // Pre-downsample anti-alias filtering
@@ -468,7 +452,7 @@ public:
 
             if (out2_connected)
             {
-                out2 = simd::float_4(0.f, mid_.lp()[2], mid_.bp()[2], mid_.hp()[2]);
+                out2 = simd::float_4(0.f, filters_.lp()[2], filters_.bp()[2], filters_.hp()[2]);
                 out2 = simd::clamp(out2, -kClampVoltage, kClampVoltage);
                 out2 = down_filter_[1].Process(out2);
             }
@@ -497,8 +481,7 @@ protected:
     int oversampling_;
     UpsamplingAAFilter<simd::float_4> up_filter_[3];
     DownsamplingAAFilter<simd::float_4> down_filter_[2];
-    LPFilter<simd::float_4> low_high_;
-    SVFilter<simd::float_4> mid_;
+    FilterBank filters_;
     dsp::TRCFilter<simd::float_4> freq_lpf_;
     dsp::TRCFilter<simd::float_4> q_lpf_;
     dsp::TRCFilter<float> clip_hpf_;
@@ -116,6 +116,59 @@ struct GroupBuilder {
 	}
 };
 
+/** Band-limits the resets of a free-running looping segment with polyBLEP, once it loops at audio rate.
+The naive ramp jumps back within a single sample, which aliases badly when the loop is used as an oscillator.
+The output is delayed by one sample, so the correction can reach back to the sample before each reset.
+*/
+struct LoopBlep {
+	/** Loops longer than this many samples are left as they are, since they barely alias */
+	static constexpr float MAX_PERIOD = 512.f;
+
+	bool active = false;
+	float lastPhase = 0.f;
+	float lastValue = 0.f;
+	float lastSlope = 0.f;
+	/** Previous sample, which still receives the correction for a reset in the next sample */
+	float pending = 0.f;
+
+	/** Replaces `values` with their band-limited version, one sample late. */
+	void process(float* values, const float* phases, int size) {
+		if (!active) {
+			active = true;
+			lastPhase = phases[0];
+			lastValue = values[0];
+			lastSlope = 0.f;
+			pending = values[0];
+		}
+
+		for (int i = 0; i < size; i++) {
+			float value = values[i];
+			float phase = phases[i];
+			float corrected = value;
+			if (phase < lastPhase) {
+				float delta = phase + 1.f - lastPhase;
+				if (delta * MAX_PERIOD > 1.f) {
+					// Time since the reset, in samples
+					float t = clamp(phase / delta, 0.f, 1.f);
+					// Size of the jump, from the value the ramp would have reached by now
+					float h = value - lastValue - lastSlope;
+					pending += h * 0.5f * t * t;
+					corrected += h * (t - 0.5f * t * t - 0.5f);
+				}
+				// Keep the slope from before the reset for the next one
+			}
+			else {
+				lastSlope = value - lastValue;
+			}
+			lastPhase = phase;
+			lastValue = value;
+
+			values[i] = pending;
+			pending = corrected;
+		}
+	}
+};
+
 struct Stages : Module {
 	enum ParamIds {
 		ENUMS(SHAPE_PARAMS, NUM_CHANNELS),
@@ -148,6 +201,7 @@ struct Stages : Module {
 
 	// Buffers
 	float envelopeBuffer[NUM_CHANNELS][BLOCK_SIZE] = {};
+	LoopBlep loopBleps[NUM_CHANNELS];
 	stmlib::GateFlags last_gate_flags[NUM_CHANNELS] = {};
 	stmlib::GateFlags gate_flags[NUM_CHANNELS][BLOCK_SIZE] = {};
 	int blockIndex = 0;
@@ -229,8 +283,14 @@ struct Stages : Module {
 		// See if the group associations have changed since the last group
 		bool groups_changed = groupBuilder.buildGroups(&inputs, GATE_INPUTS, NUM_CHANNELS);
 
+		if (groups_changed) {
+			for (int i = 0; i < NUM_CHANNELS; i++)
+				loopBleps[i].active = false;
+		}
+
 		// Process block
 		stages::SegmentGenerator::Output out[BLOCK_SIZE] = {};
+		float phases[BLOCK_SIZE];
 		for (int i = 0; i < groupBuilder.groupCount; i++) {
 			GroupInfo& group = groupBuilder.groups[i];
 
@@ -277,6 +337,17 @@ struct Stages : Module {
 				}
 				// First group segment gets the actual output
 				envelopeBuffer[group.first_segment][j] = out[j].value;
+				phases[j] = out[j].phase;
+			}
+
+			// A lone looping ramp runs freely and can reach audio rate
+			LoopBlep& loopBlep = loopBleps[group.first_segment];
+			const stages::segment::Configuration& configuration = configurations[group.first_segment];
+			if (group.segment_count == 1 && !group.gated && configuration.loop && configuration.type == stages::segment::TYPE_RAMP) {
+				loopBlep.process(envelopeBuffer[group.first_segment], phases, BLOCK_SIZE);
+			}
+			else {
+				loopBlep.active = false;
 			}
 		}
 	}
@@ -320,6 +391,8 @@ struct Stages : Module {
 	}
 
 	void process(const ProcessArgs& args) override {
+		DenormalGuard denormalGuard;
+
 		// Oscillate flashing the type lights
 		lightOscillatorPhase += 0.5f * args.sampleTime;
 		if (lightOscillatorPhase >= 1.0f)
@@ -107,9 +107,33 @@ struct Streams : Module {
 		NUM_LIGHTS
 	};
 
+	struct SettingsCommand {
+		enum Type {
+			APPLY_SETTINGS,
+			RANDOMIZE,
+			SET_DIRECT,
+		};
+		Type type;
+		int value;
+		streams::UiSettings settings;
+	};
+
 	streams::StreamsEngine engines[PORT_MAX_CHANNELS];
 	int prevNumChannels;
 	float brightnesses[NUM_LIGHTS][PORT_MAX_CHANNELS];
+	CommandQueue<SettingsCommand> commands;
+	/** Settings of the last APPLY_SETTINGS command, which the menu and dataToJson() show until the audio thread has applied it */
+	streams::UiSettings requestedSettings = {};
+	std::atomic<uint32_t> requestedGeneration{0};
+	std::atomic<uint32_t> appliedGeneration{0};
+	/** Whether the digital engine is ticked one sample at a time with linear interpolation instead of through the band-limited resampler, as last requested */
+	bool direct = false;
+	/** Direct mode as applied by the audio thread */
+	bool selectedDirect = false;
+	/** Whether the engines are in direct mode, which they also are while the plugin is over its CPU budget */
+	bool activeDirect = false;
+	QualityTierSetting qualityTier;
+	GovernorClient governorClient;
 
 	Streams() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -147,6 +171,7 @@ struct Streams : Module {
 
 		prevNumChannels = 1;
 		onSampleRateChange();
+		setDirect(false);
 	}
 
 	void onSampleRateChange() override {
@@ -158,7 +183,7 @@ struct Streams : Module {
 	}
 
 	json_t* dataToJson() override {
-		streams::UiSettings settings = engines[0].ui_settings();
+		streams::UiSettings settings = uiSettings();
 		json_t* rootJ = json_object();
 		json_object_set_new(rootJ, "function1",    json_integer(settings.function[0]));
 		json_object_set_new(rootJ, "function2",    json_integer(settings.function[1]));
@@ -166,6 +191,8 @@ struct Streams : Module {
 		json_object_set_new(rootJ, "alternate2",   json_integer(settings.alternate[1]));
 		json_object_set_new(rootJ, "monitorMode", json_integer(settings.monitor_mode));
 		json_object_set_new(rootJ, "linked",       json_integer(settings.linked));
+		json_object_set_new(rootJ, "direct",       json_boolean(direct));
+		json_object_set_new(rootJ, "qualityTier",  json_integer(qualityTier.requested));
 		return rootJ;
 	}
 
@@ -192,28 +219,54 @@ struct Streams : Module {
 		if (linkedJ)
 			settings.linked       = json_integer_value(linkedJ);
 
-		for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
-			engines[c].ApplySettings(settings);
-		}
+		applySettings(settings);
+
+		json_t* directJ = json_object_get(rootJ, "direct");
+		if (directJ)
+			setDirect(json_boolean_value(directJ));
+
+		qualityTierFromJson(rootJ, &qualityTier);
 	}
 
 	void onRandomize() override {
-		for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
-			engines[c].Randomize();
-		}
+		SettingsCommand command = {};
+		command.type = SettingsCommand::RANDOMIZE;
+		commands.push(command);
+	}
+
+	/** Returns the settings as last requested, or the engines' settings if every request has been applied. */
+	streams::UiSettings uiSettings() {
+		if (appliedGeneration.load(std::memory_order_acquire) != requestedGeneration.load(std::memory_order_relaxed))
+			return requestedSettings;
+		return engines[0].ui_settings();
+	}
+
+	/** Queues new settings for all engines. Called from the UI thread. */
+	void applySettings(const streams::UiSettings& settings) {
+		SettingsCommand command = {};
+		command.type = SettingsCommand::APPLY_SETTINGS;
+		command.settings = settings;
+		requestedSettings = settings;
+		if (commands.push(command))
+			requestedGeneration.fetch_add(1, std::memory_order_relaxed);
 	}
 
 	void setLinked(bool linked) {
-		streams::UiSettings settings = engines[0].ui_settings();
+		streams::UiSettings settings = uiSettings();
 		settings.linked = linked;
+		applySettings(settings);
+	}
 
-		for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
-			engines[c].ApplySettings(settings);
-		}
+	void setDirect(bool direct) {
+		this->direct = direct;
+		SettingsCommand command = {};
+		command.type = SettingsCommand::SET_DIRECT;
+		command.value = direct;
+		commands.push(command);
 	}
 
 	int getChannelMode(int channel) {
-		streams::UiSettings settings = engines[0].ui_settings();
+		streams::UiSettings settings = uiSettings();
 		// Search channel mode index in table
 		for (int i = 0; i < streams::kNumChannelModes; i++) {
 			if (settings.function[channel] == streams::kChannelModeTable[i].function
@@ -224,41 +277,63 @@ struct Streams : Module {
 	}
 
 	void setChannelMode(int channel, int mode_id) {
-		streams::UiSettings settings = engines[0].ui_settings();
+		streams::UiSettings settings = uiSettings();
 		settings.function[channel] = streams::kChannelModeTable[mode_id].function;
 		settings.alternate[channel] = streams::kChannelModeTable[mode_id].alternate;
-
-		for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
-			engines[c].ApplySettings(settings);
-		}
+		applySettings(settings);
 	}
 
 	void setMonitorMode(int mode_id) {
-		streams::UiSettings settings = engines[0].ui_settings();
+		streams::UiSettings settings = uiSettings();
 		settings.monitor_mode = streams::kMonitorModeTable[mode_id].mode;
+		applySettings(settings);
+	}
 
-		for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
-			engines[c].ApplySettings(settings);
+	/** Applies a settings change on the audio thread.
+	Only active engines are updated. The others are synced to engines[0] when their channel becomes active.
+	*/
+	void applyCommand(const SettingsCommand& command, int numChannels) {
+		switch (command.type) {
+			case SettingsCommand::APPLY_SETTINGS:
+				for (int c = 0; c < numChannels; c++) {
+					engines[c].ApplySettings(command.settings);
+				}
+				appliedGeneration.fetch_add(1, std::memory_order_release);
+				break;
+			case SettingsCommand::RANDOMIZE:
+				// Each engine draws its own settings, as they did before settings changes were queued
+				for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+					engines[c].Randomize();
+				}
+				break;
+			case SettingsCommand::SET_DIRECT:
+				// Not a UI setting. The engines are switched in process(), together with the governor's changes.
+				selectedDirect = command.value;
+				break;
 		}
 	}
 
 	int function(int channel) {
-		return engines[0].ui_settings().function[channel];
+		return uiSettings().function[channel];
 	}
 
 	int alternate(int channel) {
-		return engines[0].ui_settings().alternate[channel];
+		return uiSettings().alternate[channel];
 	}
 
 	bool linked() {
-		return engines[0].ui_settings().linked;
+		return uiSettings().linked;
 	}
 
 	int monitorMode() {
-		return engines[0].ui_settings().monitor_mode;
+		return uiSettings().monitor_mode;
 	}
 
 	void process(const ProcessArgs& args) override {
+		DenormalGuard denormalGuard;
+		GovernorClient::Timer governorTimer(governorClient, args.sampleTime);
+		qualityTier.apply();
+
 		int numChannels = std::max(inputs[CH1_SIGNAL_INPUT].getChannels(), inputs[CH2_SIGNAL_INPUT].getChannels());
 		numChannels = std::max(numChannels, 1);
 
@@ -270,6 +345,19 @@ struct Streams : Module {
 
 		prevNumChannels = numChannels;
 
+		commands.drain([&](const SettingsCommand& command) {
+			applyCommand(command, numChannels);
+		});
+
+		// Direct mode replaces the band-limited resampler with cheaper linear interpolation, so it is also used in eco quality and while the plugin is over its CPU budget
+		bool targetDirect = selectedDirect || qualityTier.tier == QUALITY_ECO || governor.isReduced();
+		if (targetDirect != activeDirect) {
+			activeDirect = targetDirect;
+			for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+				engines[c].SetDirect(activeDirect);
+			}
+		}
+
 		// Reuse the same frame object for multiple engines because the params
 		// aren't touched.
 		streams::StreamsEngine::Frame frame;
@@ -294,18 +382,25 @@ struct Streams : Module {
 
 		bool lights_updated = false;
 
+		// Move port voltages in bulk, so the engine loop only touches plain arrays
+		float in[NUM_INPUTS][16];
+		for (int i = 0; i < NUM_INPUTS; i++) {
+			loadPolyVoltages(inputs[i], in[i], numChannels);
+		}
+		float out[NUM_OUTPUTS][16] = {};
+
 		for (int c = 0; c < numChannels; c++) {
-			frame.ch1.excite_in = inputs[CH1_EXCITE_INPUT].getPolyVoltage(c);
-			frame.ch1.signal_in = inputs[CH1_SIGNAL_INPUT].getPolyVoltage(c);
-			frame.ch1.level_cv  = inputs[CH1_LEVEL_INPUT] .getPolyVoltage(c);
-			frame.ch2.excite_in = inputs[CH2_EXCITE_INPUT].getPolyVoltage(c);
-			frame.ch2.signal_in = inputs[CH2_SIGNAL_INPUT].getPolyVoltage(c);
-			frame.ch2.level_cv  = inputs[CH2_LEVEL_INPUT] .getPolyVoltage(c);
+			frame.ch1.excite_in = in[CH1_EXCITE_INPUT][c];
+			frame.ch1.signal_in = in[CH1_SIGNAL_INPUT][c];
+			frame.ch1.level_cv  = in[CH1_LEVEL_INPUT] [c];
+			frame.ch2.excite_in = in[CH2_EXCITE_INPUT][c];
+			frame.ch2.signal_in = in[CH2_SIGNAL_INPUT][c];
+			frame.ch2.level_cv  = in[CH2_LEVEL_INPUT] [c];
 
 			engines[c].Process(frame);
 
-			outputs[CH1_SIGNAL_OUTPUT].setVoltage(frame.ch1.signal_out, c);
-			outputs[CH2_SIGNAL_OUTPUT].setVoltage(frame.ch2.signal_out, c);
+			out[CH1_SIGNAL_OUTPUT][c] = frame.ch1.signal_out;
+			out[CH2_SIGNAL_OUTPUT][c] = frame.ch2.signal_out;
 
 			if (frame.lights_updated) {
 				brightnesses[CH1_LIGHT_1_G][c] = frame.ch1.led_green[0];
@@ -329,6 +424,10 @@ struct Streams : Module {
 			lights_updated |= frame.lights_updated;
 		}
 
+		for (int i = 0; i < NUM_OUTPUTS; i++) {
+			storeVoltages(outputs[i], out[i], numChannels);
+		}
+
 		outputs[CH1_SIGNAL_OUTPUT].setChannels(numChannels);
 		outputs[CH2_SIGNAL_OUTPUT].setChannels(numChannels);
 
@@ -421,6 +520,14 @@ struct StreamsWidget : ModuleWidget {
 			[=]() {return module->monitorMode();},
 			[=](int index) {module->setMonitorMode(index);}
 		));
+
+		menu->addChild(createBoolMenuItem("Low-latency digital engine (interpolated)",
+			[=]() {return module->direct;},
+			[=](bool val) {module->setDirect(val);}
+		));
+
+		appendQualityMenu(menu, &module->qualityTier);
+		appendGovernorMenu(menu);
 	}
 };
 
@@ -123,6 +123,7 @@ public:
             float_4 v_in = _mm_movelh_ps(signal_in.v, v_out_.v);
             v_out_ = (v_in + v_out_) * simd::exp(rad_per_s * timestep) - v_in;
             v_out_ = simd::clamp(v_out_, -kClampVoltage, kClampVoltage);
+            v_out_ = flushDenormal(v_out_);
 
             // Pre-downsample anti-alias filtering
             // output will contain the lower two elements from level and the
@@ -130,8 +130,49 @@ public:
     template <int block_size>
     void Process(Frame<block_size>& frame)
     {
-        ProcessUI(frame);
+        ProcessUI(frame, block_size);
+        ProcessSamples(frame);
+    }
+
+    // Reads the knobs and buttons and updates the LEDs, advancing the UI by
+    // num_samples ticks of the processors
+    template <int block_size>
+    void ProcessUI(Frame<block_size>& frame, int num_samples)
+    {
+        float timestep = num_samples * 1.f / kSampleRate;
+
+        adc_.pots_[0] = std::round(0xFFFF * frame.ch1.shape_knob);
+        adc_.pots_[1] = std::round(0xFFFF * frame.ch1.mod_knob);
+        adc_.pots_[2] = std::round(0xFFFF * frame.ch2.shape_knob);
+        adc_.pots_[3] = std::round(0xFFFF * frame.ch2.mod_knob);
 
+        ui_.switches().SetPin(SWITCH_MODE_1,  frame.ch1.function_button);
+        ui_.switches().SetPin(SWITCH_MODE_2,  frame.ch2.function_button);
+        ui_.switches().SetPin(SWITCH_MONITOR, frame.metering_button);
+
+        ui_.Poll(timestep * 1e6);
+        ui_.DoEvents();
+
+        for (int i = 0; i < 4; i++)
+        {
+            auto led = float_4(
+                ui_.leds().intensity_green(i),
+                ui_.leds().intensity_red(i),
+                ui_.leds().intensity_green(i + 4),
+                ui_.leds().intensity_red(i + 4));
+            led = led_lpf_[i].process(timestep, led);
+
+            frame.ch1.led_green[i] = led[0];
+            frame.ch1.led_red[i]   = led[1];
+            frame.ch2.led_green[i] = led[2];
+            frame.ch2.led_red[i]   = led[3];
+        }
+    }
+
+    // Runs the processors over the audio and CV samples in the frame
+    template <int block_size>
+    void ProcessSamples(Frame<block_size>& frame)
+    {
         for (int i = 0; i < block_size; i++)
         {
             float ch1_signal_adc = clamp(frame.ch1.signal_in[i], 0.f, kVdda);
@@ -184,39 +225,6 @@ protected:
     uint16_t pwm_value_[2];
     dsp::TExponentialFilter<float_4> led_lpf_[4];
 
-    template <int block_size>
-    void ProcessUI(Frame<block_size>& frame)
-    {
-        float timestep = block_size * 1.f / kSampleRate;
-
-        adc_.pots_[0] = std::round(0xFFFF * frame.ch1.shape_knob);
-        adc_.pots_[1] = std::round(0xFFFF * frame.ch1.mod_knob);
-        adc_.pots_[2] = std::round(0xFFFF * frame.ch2.shape_knob);
-        adc_.pots_[3] = std::round(0xFFFF * frame.ch2.mod_knob);
-
-        ui_.switches().SetPin(SWITCH_MODE_1,  frame.ch1.function_button);
-        ui_.switches().SetPin(SWITCH_MODE_2,  frame.ch2.function_button);
-        ui_.switches().SetPin(SWITCH_MONITOR, frame.metering_button);
-
-        ui_.Poll(timestep * 1e6);
-        ui_.DoEvents();
-
-        for (int i = 0; i < 4; i++)
-        {
-            auto led = float_4(
-                ui_.leds().intensity_green(i),
-                ui_.leds().intensity_red(i),
-                ui_.leds().intensity_green(i + 4),
-                ui_.leds().intensity_red(i + 4));
-            led = led_lpf_[i].process(timestep, led);
-
-            frame.ch1.led_green[i] = led[0];
-            frame.ch1.led_red[i]   = led[1];
-            frame.ch2.led_green[i] = led[2];
-            frame.ch2.led_red[i]   = led[3];
-        }
-    }
-
     static constexpr int kUiPollRate = 4000;
     static constexpr float kVdda = 3.3f;
     static constexpr int kPWMPeriod = 65535;
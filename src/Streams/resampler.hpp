@@ -112,20 +112,27 @@ public:
         ratio_inverse_ = 1.f / ratio_;
     }
 
-    void Reset(void)
+    using InputFrame = dsp::Frame<num_inputs>;
+    using OutputFrame = dsp::Frame<num_outputs>;
+
+    // Clears the buffers. The latency is filled with `output` and the input
+    // is interpolated from `input`, so the resampler can take over from
+    // another signal path mid-stream without a step.
+    void Reset(const InputFrame& input = InputFrame(),
+        const OutputFrame& output = OutputFrame())
     {
         in_buffer_.clear();
         out_buffer_.clear();
-        out_buffer_.endIncr(block_size);
+        for (int i = 0; i < block_size; i++)
+        {
+            out_buffer_.push(output);
+        }
         in_phase_ = 1.f;
-        prev_input_ = {};
-        prev_output_ = {};
-        next_output_ = {};
+        prev_input_ = input;
+        prev_output_ = output;
+        next_output_ = output;
     }
 
-    using InputFrame = dsp::Frame<num_inputs>;
-    using OutputFrame = dsp::Frame<num_outputs>;
-
     template <typename F>
     OutputFrame Process(InputFrame& input_frame, F callback)
     {
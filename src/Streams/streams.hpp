@@ -66,6 +66,7 @@ public:
 
     StreamsEngine()
     {
+        direct_ = false;
         Reset();
         SetSampleRate(1.f);
     }
@@ -78,6 +79,11 @@ public:
         digital_engine_.Reset();
         adc_feedback_[0] = 0.f;
         adc_feedback_[1] = 0.f;
+        prev_input_ = {};
+        prev_output_ = {};
+        held_output_ = {};
+        tick_phase_ = 0.f;
+        ui_ticks_ = 0;
     }
 
     void SetSampleRate(float sample_rate)
@@ -85,6 +91,27 @@ public:
         adc_lpf_.setCutoffFreq(kAdcFilterCutoff / sample_rate);
         resampler_.Init(sample_rate, DigitalEngine::kSampleRate, 0);
         analog_engine_.SetSampleRate(sample_rate);
+        tick_increment_ = DigitalEngine::kSampleRate / sample_rate;
+    }
+
+    // In direct mode, the digital engine still runs at its own rate, but is
+    // ticked one sample at a time from the host rate with linear
+    // interpolation instead of running in blocks behind the band-limited
+    // resampler.
+    // Each path takes over from the other's last input and output, so
+    // switching doesn't click.
+    void SetDirect(bool direct)
+    {
+        if (direct == direct_)
+        {
+            return;
+        }
+
+        direct_ = direct;
+        if (!direct_)
+        {
+            resampler_.Reset(prev_input_, held_output_);
+        }
     }
 
     void Randomize(void)
@@ -135,62 +162,50 @@ public:
         adc_input = kAdcFilterOffset + adc_input * kAdcFilterGain;
         adc_input.store(d_input.samples);
 
-        DigitalEngine::Frame<kBlockSize> d_frame;
+        Rsmp::OutputFrame d_output;
 
-        Rsmp::OutputFrame d_output = resampler_.Process(d_input,
-        [&](Rsmp::OutputFrame* output, const Rsmp::InputFrame* input)
+        if (direct_)
         {
-            d_frame.ch1.shape_knob          = frame.ch1.shape_knob;
-            d_frame.ch1.mod_knob            = frame.ch1.mod_knob;
-            d_frame.ch1.level_mod_knob      = frame.ch1.level_mod_knob;
-            d_frame.ch1.response_knob       = frame.ch1.response_knob;
-            d_frame.ch2.shape_knob          = frame.ch2.shape_knob;
-            d_frame.ch2.mod_knob            = frame.ch2.mod_knob;
-            d_frame.ch2.level_mod_knob      = frame.ch2.level_mod_knob;
-            d_frame.ch2.response_knob       = frame.ch2.response_knob;
-
-            d_frame.ch1.function_button     = frame.ch1.function_button;
-            d_frame.ch2.function_button     = frame.ch2.function_button;
-            d_frame.metering_button         = frame.metering_button;
-
-            for (int i = 0; i < kBlockSize; i++)
-            {
-                d_frame.ch1.signal_in[i]    = input[i].samples[0];
-                d_frame.ch2.signal_in[i]    = input[i].samples[1];
-                d_frame.ch1.excite_in[i]    = input[i].samples[2];
-                d_frame.ch2.excite_in[i]    = input[i].samples[3];
-                d_frame.ch1.level_adc_in[i] = input[i].samples[4];
-                d_frame.ch2.level_adc_in[i] = input[i].samples[5];
-            }
-
-            digital_engine_.Process(d_frame);
+            d_output = ProcessDirect(frame, d_input);
+        }
+        else
+        {
+            DigitalEngine::Frame<kBlockSize> d_frame;
 
-            for (int i = 0; i < kBlockSize; i++)
+            d_output = resampler_.Process(d_input,
+            [&](Rsmp::OutputFrame* output, const Rsmp::InputFrame* input)
             {
-                output[i].samples[0] = d_frame.ch1.dac_out[i];
-                output[i].samples[1] = d_frame.ch1.pwm_out[i];
-                output[i].samples[2] = d_frame.ch2.dac_out[i];
-                output[i].samples[3] = d_frame.ch2.pwm_out[i];
-            }
-
-            frame.ch1.led_green[0] = d_frame.ch1.led_green[0];
-            frame.ch1.led_green[1] = d_frame.ch1.led_green[1];
-            frame.ch1.led_green[2] = d_frame.ch1.led_green[2];
-            frame.ch1.led_green[3] = d_frame.ch1.led_green[3];
-            frame.ch1.led_red[0]   = d_frame.ch1.led_red[0];
-            frame.ch1.led_red[1]   = d_frame.ch1.led_red[1];
-            frame.ch1.led_red[2]   = d_frame.ch1.led_red[2];
-            frame.ch1.led_red[3]   = d_frame.ch1.led_red[3];
-            frame.ch2.led_green[0] = d_frame.ch2.led_green[0];
-            frame.ch2.led_green[1] = d_frame.ch2.led_green[1];
-            frame.ch2.led_green[2] = d_frame.ch2.led_green[2];
-            frame.ch2.led_green[3] = d_frame.ch2.led_green[3];
-            frame.ch2.led_red[0]   = d_frame.ch2.led_red[0];
-            frame.ch2.led_red[1]   = d_frame.ch2.led_red[1];
-            frame.ch2.led_red[2]   = d_frame.ch2.led_red[2];
-            frame.ch2.led_red[3]   = d_frame.ch2.led_red[3];
-            frame.lights_updated   = true;
-        });
+                SetControls(d_frame, frame);
+
+                for (int i = 0; i < kBlockSize; i++)
+                {
+                    d_frame.ch1.signal_in[i]    = input[i].samples[0];
+                    d_frame.ch2.signal_in[i]    = input[i].samples[1];
+                    d_frame.ch1.excite_in[i]    = input[i].samples[2];
+                    d_frame.ch2.excite_in[i]    = input[i].samples[3];
+                    d_frame.ch1.level_adc_in[i] = input[i].samples[4];
+                    d_frame.ch2.level_adc_in[i] = input[i].samples[5];
+                }
+
+                digital_engine_.Process(d_frame);
+
+                for (int i = 0; i < kBlockSize; i++)
+                {
+                    output[i].samples[0] = d_frame.ch1.dac_out[i];
+                    output[i].samples[1] = d_frame.ch1.pwm_out[i];
+                    output[i].samples[2] = d_frame.ch2.dac_out[i];
+                    output[i].samples[3] = d_frame.ch2.pwm_out[i];
+                }
+
+                GetLights(d_frame, frame);
+            });
+
+            // Keep the last output so switching to direct mode is seamless
+            prev_output_ = d_output;
+            held_output_ = d_output;
+        }
+
+        prev_input_ = d_input;
 
         AnalogEngine::Frame a_frame;
 
@@ -231,7 +246,114 @@ protected:
     Rsmp resampler_;
     AnalogEngine analog_engine_;
     DigitalEngine digital_engine_;
+    DigitalEngine::Frame<1> tick_frame_;
+    Rsmp::InputFrame prev_input_;
+    // Outputs of the last two ticks in direct mode
+    Rsmp::OutputFrame prev_output_;
+    Rsmp::OutputFrame held_output_;
     float adc_feedback_[2];
+    float tick_phase_;
+    float tick_increment_;
+    int ui_ticks_;
+    bool direct_;
+
+    // Ticks the digital engine at its own rate from a phase accumulator,
+    // without the resampler's block latency.
+    // Inputs are linearly interpolated to the time of each tick, and outputs
+    // are linearly interpolated between the last two ticks, which delays
+    // them by at most one tick. Holding them instead would jitter by up to
+    // a host sample against the tick clock.
+    // The UI is still polled once every kBlockSize ticks.
+    Rsmp::OutputFrame ProcessDirect(Frame& frame,
+        const Rsmp::InputFrame& input)
+    {
+        DigitalEngine::Frame<1>& d_frame = tick_frame_;
+
+        tick_phase_ += tick_increment_;
+
+        while (tick_phase_ >= 1.f)
+        {
+            tick_phase_ -= 1.f;
+
+            // Position of the tick between the previous host frame and this
+            // one
+            float x = 1.f - tick_phase_ / tick_increment_;
+            Rsmp::InputFrame tick_input;
+            for (int i = 0; i < 6; i++)
+            {
+                tick_input.samples[i] = prev_input_.samples[i] +
+                    (input.samples[i] - prev_input_.samples[i]) * x;
+            }
+
+            if (ui_ticks_ == 0)
+            {
+                SetControls(d_frame, frame);
+                digital_engine_.ProcessUI(d_frame, kBlockSize);
+                GetLights(d_frame, frame);
+            }
+
+            ui_ticks_ = (ui_ticks_ + 1) % kBlockSize;
+
+            d_frame.ch1.signal_in[0]    = tick_input.samples[0];
+            d_frame.ch2.signal_in[0]    = tick_input.samples[1];
+            d_frame.ch1.excite_in[0]    = tick_input.samples[2];
+            d_frame.ch2.excite_in[0]    = tick_input.samples[3];
+            d_frame.ch1.level_adc_in[0] = tick_input.samples[4];
+            d_frame.ch2.level_adc_in[0] = tick_input.samples[5];
+
+            digital_engine_.ProcessSamples(d_frame);
+
+            prev_output_ = held_output_;
+            held_output_.samples[0] = d_frame.ch1.dac_out[0];
+            held_output_.samples[1] = d_frame.ch1.pwm_out[0];
+            held_output_.samples[2] = d_frame.ch2.dac_out[0];
+            held_output_.samples[3] = d_frame.ch2.pwm_out[0];
+        }
+
+        // tick_phase_ is the time since the last tick, in ticks
+        Rsmp::OutputFrame output;
+        for (int i = 0; i < 4; i++)
+        {
+            output.samples[i] = prev_output_.samples[i] +
+                (held_output_.samples[i] - prev_output_.samples[i]) *
+                tick_phase_;
+        }
+
+        return output;
+    }
+
+    template <int block_size>
+    void SetControls(DigitalEngine::Frame<block_size>& d_frame,
+        const Frame& frame)
+    {
+        d_frame.ch1.shape_knob          = frame.ch1.shape_knob;
+        d_frame.ch1.mod_knob            = frame.ch1.mod_knob;
+        d_frame.ch1.level_mod_knob      = frame.ch1.level_mod_knob;
+        d_frame.ch1.response_knob       = frame.ch1.response_knob;
+        d_frame.ch2.shape_knob          = frame.ch2.shape_knob;
+        d_frame.ch2.mod_knob            = frame.ch2.mod_knob;
+        d_frame.ch2.level_mod_knob      = frame.ch2.level_mod_knob;
+        d_frame.ch2.response_knob       = frame.ch2.response_knob;
+
+        d_frame.ch1.function_button     = frame.ch1.function_button;
+        d_frame.ch2.function_button     = frame.ch2.function_button;
+        d_frame.metering_button         = frame.metering_button;
+    }
+
+    template <int block_size>
+    void GetLights(const DigitalEngine::Frame<block_size>& d_frame,
+        Frame& frame)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            frame.ch1.led_green[i] = d_frame.ch1.led_green[i];
+            frame.ch1.led_red[i]   = d_frame.ch1.led_red[i];
+            frame.ch2.led_green[i] = d_frame.ch2.led_green[i];
+            frame.ch2.led_red[i]   = d_frame.ch2.led_red[i];
+        }
+
+        frame.lights_updated = true;
+    }
 };
 
 }
@@ -82,6 +82,8 @@ struct Tides : Module {
 	}
 
 	void process(const ProcessArgs& args) override {
+		DenormalGuard denormalGuard;
+
 		tides::GeneratorMode mode = generator.mode();
 		if (modeTrigger.process(params[MODE_PARAM].getValue())) {
 			mode = (tides::GeneratorMode)(((int)mode - 1 + 3) % 3);
@@ -61,6 +61,8 @@ struct Warps : Module {
 	}
 
 	void process(const ProcessArgs& args) override {
+		DenormalGuard denormalGuard;
+
 		// State trigger
 		warps::Parameters* p = modulator.mutable_parameters();
 		if (stateTrigger.process(params[STATE_PARAM].getValue())) {
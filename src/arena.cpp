@@ -0,0 +1,128 @@
+#include "plugin.hpp"
+#include <mutex>
+#if defined(ARCH_WIN)
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+#endif
+
+
+/** Returns `size` bytes of zeroed, uncommitted pages, or NULL. */
+static void* mapPages(size_t size) {
+#if defined(ARCH_WIN)
+	return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return (p == MAP_FAILED) ? NULL : p;
+#endif
+}
+
+
+static void unmapPages(void* p, size_t size) {
+#if defined(ARCH_WIN)
+	VirtualFree(p, 0, MEM_RELEASE);
+#else
+	munmap(p, size);
+#endif
+}
+
+
+#if defined(ARCH_LIN)
+/** Maps `size` bytes, rounded up to whole huge pages, aligned to a huge page and advised to use transparent huge pages.
+Returns NULL on failure.
+*/
+static void* mapHugePages(size_t size, size_t* mappedSize) {
+	size = (size + Arena::HUGE_PAGE_SIZE - 1) / Arena::HUGE_PAGE_SIZE * Arena::HUGE_PAGE_SIZE;
+	// Over-allocate by one huge page so the block can be aligned to it, then give the unaligned ends back
+	size_t paddedSize = size + Arena::HUGE_PAGE_SIZE;
+	uint8_t* p = (uint8_t*) mapPages(paddedSize);
+	if (!p)
+		return NULL;
+	uint8_t* start = (uint8_t*) (((uintptr_t) p + Arena::HUGE_PAGE_SIZE - 1) / Arena::HUGE_PAGE_SIZE * Arena::HUGE_PAGE_SIZE);
+	if (start > p)
+		munmap(p, start - p);
+	if (p + paddedSize > start + size)
+		munmap(start + size, p + paddedSize - (start + size));
+	madvise(start, size, MADV_HUGEPAGE);
+	*mappedSize = size;
+	return start;
+}
+#endif
+
+
+/** A huge page shared by arenas smaller than HUGE_PAGE_MIN.
+Arenas are carved from it in order, and their space isn't reused when they are destroyed, so every arena gets zeroed memory.
+The slab is unmapped when its last arena is destroyed.
+*/
+struct Arena::Slab {
+	uint8_t* data = NULL;
+	size_t used = 0;
+	int arenas = 0;
+};
+
+/** Guards the slabs. Arenas are created and destroyed on the engine and UI threads, never while processing. */
+static std::mutex slabMutex;
+/** Slab that new small arenas are carved from */
+static Arena::Slab* currentSlab = NULL;
+
+
+Arena::~Arena() {
+	if (slab) {
+		std::lock_guard<std::mutex> lock(slabMutex);
+		if (--slab->arenas == 0) {
+			if (slab == currentSlab)
+				currentSlab = NULL;
+			unmapPages(slab->data, HUGE_PAGE_SIZE);
+			delete slab;
+		}
+		return;
+	}
+	if (mapping)
+		unmapPages(mapping, mappingSize);
+}
+
+
+void Arena::init(size_t size) {
+	assert(!mapping && !slab);
+	size = (size + ALIGN - 1) / ALIGN * ALIGN;
+
+#if defined(ARCH_LIN)
+	if (size < HUGE_PAGE_MIN) {
+		std::lock_guard<std::mutex> lock(slabMutex);
+		if (!currentSlab || currentSlab->used + size > HUGE_PAGE_SIZE) {
+			size_t mappedSize;
+			uint8_t* slabData = (uint8_t*) mapHugePages(HUGE_PAGE_SIZE, &mappedSize);
+			if (!slabData)
+				throw Exception("Could not allocate %zu bytes", size);
+			// The previous slab is freed by its last arena
+			currentSlab = new Slab;
+			currentSlab->data = slabData;
+		}
+		slab = currentSlab;
+		data = slab->data + slab->used;
+		slab->used += size;
+		slab->arenas++;
+	}
+	else {
+		mapping = mapHugePages(size, &mappingSize);
+		if (!mapping)
+			throw Exception("Could not allocate %zu bytes", size);
+		data = (uint8_t*) mapping;
+	}
+#else
+	mappingSize = size;
+	mapping = mapPages(mappingSize);
+	if (!mapping)
+		throw Exception("Could not allocate %zu bytes", size);
+	data = (uint8_t*) mapping;
+#endif
+
+	this->size = size;
+	used = 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <rack.hpp>
+
+
+/** One block of memory per module instance, from which its hardware emulation buffers are carved.
+
+The block comes straight from the OS, so it is zeroed and its pages are only committed when first written.
+On Linux, the block is backed by transparent huge pages, which cuts TLB misses in patches with many instances.
+Arenas of at least HUGE_PAGE_MIN bytes get their own 2 MB-aligned mapping.
+Smaller arenas are packed together into shared 2 MB slabs, so small modules don't each pin a 2 MB page.
+
+Memory is returned to the OS when the arena is destroyed, or for a shared slab, when the last arena carved from it is destroyed.
+Objects carved from the arena are not constructed or destroyed by it. Use placement new and call destructors explicitly where needed.
+*/
+struct Arena {
+	static constexpr size_t ALIGN = 64;
+	static constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+	static constexpr size_t HUGE_PAGE_MIN = 1 << 20;
+
+	struct Slab;
+
+	uint8_t* data = NULL;
+	size_t size = 0;
+	size_t used = 0;
+	/** Start and length of the OS mapping, which can be larger than `size` */
+	void* mapping = NULL;
+	size_t mappingSize = 0;
+	/** Shared slab the block was carved from, or NULL if the arena owns its mapping */
+	Slab* slab = NULL;
+
+	Arena() {}
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+	~Arena();
+
+	/** Returns the bytes needed by `count` objects of type T, including alignment padding. */
+	template <typename T>
+	static constexpr size_t sizeOf(size_t count = 1) {
+		return (sizeof(T) * count + ALIGN - 1) / ALIGN * ALIGN;
+	}
+
+	/** Allocates the block. Must be called once, before alloc(). */
+	void init(size_t size);
+
+	/** Returns zeroed memory for `count` objects of type T, aligned to a cache line. */
+	template <typename T>
+	T* alloc(size_t count = 1) {
+		size_t bytes = sizeOf<T>(count);
+		assert(used + bytes <= size);
+		T* p = (T*) (data + used);
+		used += bytes;
+		return p;
+	}
+};
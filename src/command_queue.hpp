@@ -0,0 +1,30 @@
+#pragma once
+
+#include <rack.hpp>
+
+
+/** Hands settings changes from the UI thread to the audio thread without locking.
+Context menu actions, dataFromJson() and onRandomize() push commands, and process() applies them at its next block boundary with drain().
+There must be only one producer thread and one consumer thread.
+Commands pushed while the queue is full are dropped with a warning in the log, and push() returns false.
+*/
+template <typename T, size_t S = 16>
+struct CommandQueue {
+	rack::dsp::RingBuffer<T, S> buffer;
+
+	bool push(const T& command) {
+		if (buffer.full()) {
+			WARN("Settings command queue is full, dropping a settings change");
+			return false;
+		}
+		buffer.push(command);
+		return true;
+	}
+
+	/** Calls `f(command)` for each pending command, in the order they were pushed. */
+	template <typename F>
+	void drain(F f) {
+		while (!buffer.empty())
+			f(buffer.shift());
+	}
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <rack.hpp>
+#if defined(__SSE__)
+	#include <xmmintrin.h>
+#endif
+
+
+/** Enables flush-to-zero and denormals-are-zero on the calling thread for the lifetime of the guard.
+The previous floating point mode is restored on destruction.
+If the host has already enabled both modes, the guard only reads the control register.
+*/
+struct DenormalGuard {
+#if defined(__SSE__)
+	static constexpr unsigned int MASK = 0x8040; // FTZ | DAZ
+	unsigned int csr;
+
+	DenormalGuard() {
+		csr = _mm_getcsr();
+		if ((csr & MASK) != MASK)
+			_mm_setcsr(csr | MASK);
+	}
+	~DenormalGuard() {
+		if ((csr & MASK) != MASK)
+			_mm_setcsr(csr);
+	}
+#elif defined(__aarch64__)
+	static constexpr uint64_t MASK = uint64_t(1) << 24; // FZ
+	uint64_t fpcr;
+
+	DenormalGuard() {
+		__asm__ volatile("mrs %0, fpcr" : "=r"(fpcr));
+		if (!(fpcr & MASK)) {
+			uint64_t flushed = fpcr | MASK;
+			__asm__ volatile("msr fpcr, %0" : : "r"(flushed));
+		}
+	}
+	~DenormalGuard() {
+		if (!(fpcr & MASK))
+			__asm__ volatile("msr fpcr, %0" : : "r"(fpcr));
+	}
+#endif
+
+	DenormalGuard(const DenormalGuard&) = delete;
+	DenormalGuard& operator=(const DenormalGuard&) = delete;
+};
+
+
+/** Values smaller than this (about -400 dB) are inaudible and are flushed to zero in feedback state. */
+static constexpr float DENORMAL_THRESHOLD = 1e-20f;
+
+/** Returns 0 if `x` is small enough to be on its way into the denormal range.
+Use on recursive filter state so decaying tails don't depend on the FPU mode.
+*/
+inline float flushDenormal(float x) {
+	return (std::fabs(x) < DENORMAL_THRESHOLD) ? 0.f : x;
+}
+
+inline rack::simd::float_4 flushDenormal(rack::simd::float_4 x) {
+	return rack::simd::ifelse(rack::simd::fabs(x) < DENORMAL_THRESHOLD, 0.f, x);
+}
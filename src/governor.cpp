@@ -0,0 +1,101 @@
+#include "plugin.hpp"
+#include <algorithm>
+#include <utility>
+
+
+Governor governor;
+
+
+void Governor::addClient(GovernorClient* client) {
+	std::lock_guard<std::mutex> lock(mutex);
+	clients.push_back(client);
+}
+
+
+void Governor::removeClient(GovernorClient* client) {
+	std::lock_guard<std::mutex> lock(mutex);
+	clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+}
+
+
+void Governor::update(double now) {
+	std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+	if (!lock.owns_lock())
+		return;
+
+	float b = budget.load(std::memory_order_relaxed);
+	if (b <= 0.f) {
+		reduced = false;
+		return;
+	}
+
+	int64_t total = 0;
+	for (GovernorClient* client : clients) {
+		if (now - client->publishTime.load(std::memory_order_relaxed) <= STALE)
+			total += client->published.load(std::memory_order_relaxed);
+	}
+	float cost = total * 1e-6f;
+
+	if (!reduced) {
+		if (cost > b) {
+			// Back off longer if the last switch up didn't last
+			hold = (now - changeTime < hold) ? std::fmin(hold * 2.0, MAX_HOLD) : MIN_HOLD;
+			reduced = true;
+			changeTime = now;
+			headroomTime = NAN;
+		}
+	}
+	else {
+		if (cost < RECOVER * b) {
+			if (std::isnan(headroomTime))
+				headroomTime = now;
+			if (now - headroomTime >= hold && now - changeTime >= hold) {
+				reduced = false;
+				changeTime = now;
+			}
+		}
+		else {
+			headroomTime = NAN;
+		}
+	}
+}
+
+
+void Governor::setBudget(float budget) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->budget = budget;
+		if (budget <= 0.f) {
+			// update() stops being called once the clients stop timing themselves, so nothing else would switch back
+			reduced = false;
+			changeTime = -INFINITY;
+			hold = MIN_HOLD;
+			headroomTime = NAN;
+		}
+	}
+	savePluginSettings();
+}
+
+
+void appendGovernorMenu(Menu* menu) {
+	static const std::vector<std::pair<std::string, float>> budgets = {
+		{"Off", 0.f},
+		{"10% of a core", 0.1f},
+		{"25% of a core", 0.25f},
+		{"50% of a core", 0.5f},
+		{"75% of a core", 0.75f},
+	};
+
+	menu->addChild(createSubmenuItem("CPU budget for Audible Instruments",
+		[=](Menu* menu) {
+			menu->addChild(createMenuLabel(governor.isReduced() ? "Over budget, all governed modules use cheaper modes" : "Switches all governed modules to cheaper modes when exceeded"));
+			for (const auto& it : budgets) {
+				float budget = it.second;
+				menu->addChild(createCheckMenuItem(it.first,
+					[=]() {return governor.budget == budget;},
+					[=]() {governor.setBudget(budget);}
+				));
+			}
+		}
+	));
+}
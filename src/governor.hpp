@@ -0,0 +1,133 @@
+#pragma once
+
+#include <rack.hpp>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <vector>
+
+
+struct GovernorClient;
+
+
+/** Plugin-wide CPU budget for the modules that have cheaper modes.
+
+Governed instances time their own process() calls and publish their average cost every WINDOW frames, as a share of the sample period.
+When the instances together use more than the budget, the governor switches to its reduced level, and they use their cheaper modes until it switches back.
+There is one level for the whole plugin, so every governed instance switches together, however little some of them cost.
+It only switches back once the total has stayed below RECOVER times the budget for the hold time.
+The hold time doubles every time the budget is exceeded again soon after switching back, so a patch that sits near the limit doesn't keep flipping.
+Costs not published for STALE seconds, from instances that are bypassed or no longer processed, are left out of the total.
+
+The budget is a share of one core, set from the context menu of any governed module and saved in the plugin's settings file.
+With a budget of 0, the governor is off, and instances don't time themselves.
+*/
+struct Governor {
+	static constexpr int WINDOW = 4096;
+	static constexpr float RECOVER = 0.6f;
+	static constexpr double MIN_HOLD = 2.0;
+	static constexpr double MAX_HOLD = 64.0;
+	static constexpr double STALE = 1.0;
+
+	/** Share of one core that governed instances may use together, or 0 if the governor is off */
+	std::atomic<float> budget{0.f};
+	std::atomic<bool> reduced{false};
+
+	/** Guards the clients and the level state below. Engine threads only try to lock it, so they never wait for it. */
+	std::mutex mutex;
+	std::vector<GovernorClient*> clients;
+	/** Time of the last level change, and how long to wait before switching back up */
+	double changeTime = -INFINITY;
+	double hold = MIN_HOLD;
+	/** Time since which the total has been below the recovery threshold, or NAN if it isn't */
+	double headroomTime = NAN;
+
+	bool enabled() {
+		return budget.load(std::memory_order_relaxed) > 0.f;
+	}
+
+	bool isReduced() {
+		return reduced.load(std::memory_order_relaxed);
+	}
+
+	void addClient(GovernorClient* client);
+	void removeClient(GovernorClient* client);
+
+	/** Compares the total recent cost of the clients with the budget and changes the level if needed.
+	Called by the clients from engine threads. Does nothing if another thread holds the lock.
+	*/
+	void update(double now);
+
+	/** Sets the budget and saves it in the plugin settings file.
+	Turning the governor off switches back to the full level and forgets the hold time.
+	*/
+	void setBudget(float budget);
+};
+
+
+extern Governor governor;
+
+
+/** A module instance's share of the governor's budget.
+Keep one in the module, and put a GovernorClient::Timer at the top of process().
+*/
+struct GovernorClient {
+	using clock_type = std::chrono::steady_clock;
+
+	/** Cost of the last window, in millionths of the sample period, and when it was published */
+	std::atomic<int64_t> published{0};
+	std::atomic<double> publishTime{-INFINITY};
+	/** Time spent in process() during the current window, in seconds */
+	double elapsed = 0.0;
+	/** Length of the current window, in seconds */
+	double period = 0.0;
+	int frames = 0;
+
+	GovernorClient() {
+		governor.addClient(this);
+	}
+	~GovernorClient() {
+		governor.removeClient(this);
+	}
+
+	GovernorClient(const GovernorClient&) = delete;
+	GovernorClient& operator=(const GovernorClient&) = delete;
+
+	void add(double time, float sampleTime) {
+		elapsed += time;
+		period += sampleTime;
+		if (++frames < Governor::WINDOW)
+			return;
+
+		double now = rack::system::getTime();
+		published.store((int64_t) (elapsed / period * 1e6), std::memory_order_relaxed);
+		publishTime.store(now, std::memory_order_relaxed);
+		elapsed = 0.0;
+		period = 0.0;
+		frames = 0;
+		governor.update(now);
+	}
+
+	/** Times the enclosing scope if the governor is on. */
+	struct Timer {
+		GovernorClient* client = NULL;
+		float sampleTime;
+		clock_type::time_point start;
+
+		Timer(GovernorClient& client, float sampleTime) : sampleTime(sampleTime) {
+			if (!governor.enabled())
+				return;
+			this->client = &client;
+			start = clock_type::now();
+		}
+		~Timer() {
+			if (client)
+				client->add(std::chrono::duration<double>(clock_type::now() - start).count(), sampleTime);
+		}
+	};
+};
+
+
+/** Adds the shared "CPU budget" submenu to a governed module's context menu. */
+void appendGovernorMenu(rack::ui::Menu* menu);
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <rack.hpp>
+
+
+/** Sample rate converter for planar buffers, where each channel is a separate contiguous array.
+Works like dsp::SampleRateConverter, but reads and writes each channel through its own pointer, so voices don't have to be interleaved into frames before conversion.
+*/
+template <int MAX_CHANNELS>
+struct PlanarSampleRateConverter {
+	SpeexResamplerState* st = NULL;
+	int channels = MAX_CHANNELS;
+	int quality = SPEEX_RESAMPLER_QUALITY_DEFAULT;
+	int inRate = 44100;
+	int outRate = 44100;
+
+	PlanarSampleRateConverter() {
+		refreshState();
+	}
+	~PlanarSampleRateConverter() {
+		if (st)
+			speex_resampler_destroy(st);
+	}
+
+	PlanarSampleRateConverter(const PlanarSampleRateConverter&) = delete;
+	PlanarSampleRateConverter& operator=(const PlanarSampleRateConverter&) = delete;
+
+	/** Sets the number of channels to actually process. Must be at most MAX_CHANNELS. */
+	void setChannels(int channels) {
+		assert(0 < channels && channels <= MAX_CHANNELS);
+		if (channels == this->channels)
+			return;
+		this->channels = channels;
+		refreshState();
+	}
+
+	void setQuality(int quality) {
+		if (quality == this->quality)
+			return;
+		this->quality = quality;
+		refreshState();
+	}
+
+	void setRates(int inRate, int outRate) {
+		if (inRate == this->inRate && outRate == this->outRate)
+			return;
+		this->inRate = inRate;
+		this->outRate = outRate;
+		refreshState();
+	}
+
+	void refreshState() {
+		if (st) {
+			speex_resampler_destroy(st);
+			st = NULL;
+		}
+		if (channels > 0 && inRate != outRate) {
+			int err;
+			st = speex_resampler_init(channels, inRate, outRate, quality, &err);
+			(void) err;
+		}
+	}
+
+	/** Clears the history of every channel, as if the converter was just created, without reallocating it. */
+	void reset() {
+		if (st)
+			speex_resampler_reset_mem(st);
+	}
+
+	/** Converts `channels` channels, where `in[c]` and `out[c]` point to the samples of channel c.
+	`inFrames` and `outFrames` are the sizes of the buffers, and are updated to the number of frames consumed and produced.
+	*/
+	void process(float* const* in, int* inFrames, float* const* out, int* outFrames) {
+		process(0, channels, in, inFrames, out, outFrames);
+	}
+
+	/** Converts only channels `first` to `first + count - 1`, where `in[i]` and `out[i]` point to the samples of channel `first + i`.
+	The other channels keep their state, but fall behind. Once they are converted again, they can produce a frame more or less than the rest in a call, and start from the samples they were last given.
+	*/
+	void process(int first, int count, float* const* in, int* inFrames, float* const* out, int* outFrames) {
+		assert(0 <= first && first + count <= channels);
+		if (st) {
+			speex_resampler_set_input_stride(st, 1);
+			speex_resampler_set_output_stride(st, 1);
+			spx_uint32_t inLen = 0;
+			spx_uint32_t outLen = 0;
+			for (int i = 0; i < count; i++) {
+				inLen = *inFrames;
+				outLen = *outFrames;
+				speex_resampler_process_float(st, first + i, in[i], &inLen, out[i], &outLen);
+			}
+			*inFrames = inLen;
+			*outFrames = outLen;
+		}
+		else {
+			// Simply copy the buffers without conversion
+			int frames = std::min(*inFrames, *outFrames);
+			for (int i = 0; i < count; i++)
+				std::memcpy(out[i], in[i], frames * sizeof(float));
+			*inFrames = frames;
+			*outFrames = frames;
+		}
+	}
+};
+
+
+/** Ring buffer with one contiguous array per channel.
+Like dsp::DoubleRingBuffer, every sample is stored twice, so up to S consecutive samples of a channel can always be read from a single pointer.
+To append a frame, write() each channel that is in use, then call endIncr(). Channels that aren't written keep stale samples.
+*/
+template <int CHANNELS, size_t S>
+struct PlanarRingBuffer {
+	static_assert((S & (S - 1)) == 0, "S must be a power of 2");
+	float data[CHANNELS][2 * S] = {};
+	size_t start = 0;
+	size_t end = 0;
+
+	size_t mask(size_t i) const {
+		return i & (S - 1);
+	}
+	/** Sets a channel's sample in the frame being appended. */
+	void write(int channel, float x) {
+		size_t i = mask(end);
+		data[channel][i] = x;
+		data[channel][i + S] = x;
+	}
+	void endIncr() {
+		end++;
+	}
+	float* startData(int channel) {
+		return &data[channel][mask(start)];
+	}
+	void startIncr(size_t n) {
+		start += n;
+	}
+	size_t size() const {
+		return end - start;
+	}
+	bool empty() const {
+		return start == end;
+	}
+	bool full() const {
+		return end - start >= S;
+	}
+};
+
+
+/** Block of planar samples that is filled all at once and then read one frame at a time. */
+template <int CHANNELS, size_t S>
+struct PlanarBlockBuffer {
+	float data[CHANNELS][S] = {};
+	size_t pos = 0;
+	size_t len = 0;
+
+	size_t capacity() const {
+		return S;
+	}
+	/** Marks the first `len` frames as filled, after writing them through `data`. */
+	void fill(size_t len) {
+		pos = 0;
+		this->len = len;
+	}
+	/** Returns the current frame's sample of a channel. */
+	float get(int channel) const {
+		return data[channel][pos];
+	}
+	void shift() {
+		pos++;
+	}
+	bool empty() const {
+		return pos >= len;
+	}
+};
+
+
+/** Copies the first `channels` voltages of an input into `v`, four channels at a time.
+Monophonic inputs are broadcast to every channel, as with Input::getPolyVoltage().
+`v` must have room for `channels` rounded up to a multiple of 4.
+*/
+inline void loadPolyVoltages(engine::Input& input, float* v, int channels) {
+	if (input.isMonophonic()) {
+		simd::float_4 x = input.getVoltage();
+		for (int c = 0; c < channels; c += 4)
+			x.store(&v[c]);
+	}
+	else {
+		for (int c = 0; c < channels; c += 4)
+			input.getVoltageSimd<simd::float_4>(c).store(&v[c]);
+	}
+}
+
+
+/** Sets the first `channels` voltages of an output from `v`, four channels at a time.
+The lanes past `channels` in the last group of 4 are written too, so `v` should be zeroed past `channels`.
+*/
+inline void storeVoltages(engine::Output& output, const float* v, int channels) {
+	for (int c = 0; c < channels; c += 4)
+		output.setVoltageSimd(simd::float_4::load(&v[c]), c);
+}
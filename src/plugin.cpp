@@ -5,6 +5,7 @@ Plugin* pluginInstance;
 
 void init(rack::Plugin* p) {
 	pluginInstance = p;
+	loadPluginSettings();
 
 	p->addModel(modelBraids);
 	p->addModel(modelPlaits);
@@ -1,4 +1,12 @@
 #include <rack.hpp>
+#include "denormal.hpp"
+#include "command_queue.hpp"
+#include "arena.hpp"
+#include "planar.hpp"
+#include "governor.hpp"
+#include "quality.hpp"
+#include "recorder.hpp"
+#include "prng.hpp"
 
 
 using namespace rack;
@@ -6,6 +14,10 @@ using namespace rack;
 
 extern Plugin* pluginInstance;
 
+/** Loads and saves plugin-wide settings, such as the CPU budget, in the Rack user folder */
+void loadPluginSettings();
+void savePluginSettings();
+
 extern Model* modelBraids;
 extern Model* modelPlaits;
 extern Model* modelElements;
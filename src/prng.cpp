@@ -0,0 +1,31 @@
+#include "plugin.hpp"
+
+
+static uint32_t newFixedSeed() {
+	uint32_t seed = 0;
+	while (!seed)
+		seed = random::u32();
+	return seed;
+}
+
+
+void appendRandomSourceMenu(Menu* menu, RandomSource* source) {
+	menu->addChild(createSubmenuItem("Random seed",
+		[=](Menu* menu) {
+			menu->addChild(createCheckMenuItem("New seed on every load",
+				[=]() {return source->fixedSeed == 0;},
+				[=]() {source->setFixedSeed(0);}
+			));
+			menu->addChild(createCheckMenuItem(source->fixedSeed ? string::f("Fixed seed %u", source->fixedSeed) : "Fixed seed",
+				[=]() {return source->fixedSeed != 0;},
+				[=]() {
+					if (!source->fixedSeed)
+						source->setFixedSeed(newFixedSeed());
+				}
+			));
+			menu->addChild(createMenuItem("New fixed seed", "",
+				[=]() {source->setFixedSeed(newFixedSeed());}
+			));
+		}
+	));
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <rack.hpp>
+#include <cmath>
+#include <cstdint>
+#include "command_queue.hpp"
+
+
+/** Per-instance xoshiro128+ generator, for modules that draw random numbers in process().
+rack::random looks up a thread-local global generator on every call. Owning the state avoids that, and lets an instance with a fixed seed render the same output every time.
+Not thread-safe: only the audio thread should draw from it.
+*/
+struct Prng {
+	uint32_t s[4];
+	/** Second value of the last Box-Muller pair, returned by the next normal() */
+	float spare = 0.f;
+	bool hasSpare = false;
+
+	Prng() {
+		seed(0);
+	}
+
+	/** Expands a 64-bit seed into the state with splitmix64, so similar seeds give unrelated sequences. */
+	void seed(uint64_t seed) {
+		for (int i = 0; i < 4; i += 2) {
+			seed += 0x9e3779b97f4a7c15ULL;
+			uint64_t z = seed;
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			z ^= z >> 31;
+			s[i] = z;
+			s[i + 1] = z >> 32;
+		}
+		hasSpare = false;
+	}
+
+	uint32_t u32() {
+		uint32_t result = s[0] + s[3];
+		uint32_t t = s[1] << 9;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = (s[3] << 11) | (s[3] >> 21);
+		return result;
+	}
+
+	/** Returns a uniform float in [0, 1), from the top 24 bits, which are the best in xoshiro128+. */
+	float uniform() {
+		return (u32() >> 8) * (1.f / 16777216.f);
+	}
+
+	/** Returns a normal float with mean 0 and standard deviation 1. */
+	float normal() {
+		if (hasSpare) {
+			hasSpare = false;
+			return spare;
+		}
+		// Box-Muller transform, keeping the second value for the next call
+		float r = std::sqrt(-2.f * std::log(1.f - uniform()));
+		float theta = 2.f * float(M_PI) * uniform();
+		spare = r * std::sin(theta);
+		hasSpare = true;
+		return r * std::cos(theta);
+	}
+};
+
+
+/** A module's Prng with its seed setting.
+By default, each instance is seeded randomly when it is created or loaded. A fixed seed is saved with the patch, so offline renders of it are reproducible.
+Seed changes from the UI thread are queued and applied by update() on the audio thread.
+*/
+struct RandomSource {
+	Prng prng;
+	/** Seed saved with the patch, or 0 if each load draws a new one */
+	uint32_t fixedSeed = 0;
+	CommandQueue<uint64_t> seedCommands;
+
+	RandomSource() {
+		prng.seed(rack::random::u64());
+	}
+
+	/** Sets the fixed seed, or 0 for a random seed, and reseeds at the next update(). */
+	void setFixedSeed(uint32_t seed) {
+		fixedSeed = seed;
+		seedCommands.push(seed ? seed : rack::random::u64());
+	}
+
+	/** Applies seed changes. Call at the top of process(). Returns whether the generator was reseeded. */
+	bool update() {
+		bool reseeded = false;
+		seedCommands.drain([&](uint64_t seed) {
+			prng.seed(seed);
+			reseeded = true;
+		});
+		return reseeded;
+	}
+
+	void toJson(json_t* rootJ) {
+		if (fixedSeed)
+			json_object_set_new(rootJ, "seed", json_integer(fixedSeed));
+	}
+
+	void fromJson(json_t* rootJ) {
+		json_t* seedJ = json_object_get(rootJ, "seed");
+		setFixedSeed(seedJ ? (uint32_t) json_integer_value(seedJ) : 0);
+	}
+};
+
+
+/** Adds the "Random seed" submenu to a module's context menu. */
+void appendRandomSourceMenu(rack::ui::Menu* menu, RandomSource* source);
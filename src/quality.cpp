@@ -0,0 +1,26 @@
+#include "plugin.hpp"
+
+
+QualityTier defaultQualityTier = QUALITY_STANDARD;
+
+
+void appendQualityMenu(Menu* menu, QualityTierSetting* setting) {
+	static const std::vector<std::string> tierLabels = {
+		"Eco",
+		"Standard",
+		"High",
+	};
+
+	menu->addChild(createIndexSubmenuItem("Processing quality", tierLabels,
+		[=]() {return setting->requested;},
+		[=](int index) {setting->set((QualityTier) index);}
+	));
+
+	menu->addChild(createIndexSubmenuItem("Default processing quality of new modules", tierLabels,
+		[=]() {return defaultQualityTier;},
+		[=](int index) {
+			defaultQualityTier = (QualityTier) index;
+			savePluginSettings();
+		}
+	));
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <rack.hpp>
+#include "command_queue.hpp"
+
+
+/** Trade-off between CPU use and fidelity, shared by all modules that have one.
+Each module maps the tiers to its own options.
+Standard is the behavior the modules had before the tiers existed.
+*/
+enum QualityTier {
+	/** Skips sample rate conversion where the module can run without it, and otherwise uses cheaper converters and engines */
+	QUALITY_ECO,
+	QUALITY_STANDARD,
+	/** Uses higher quality sample rate converters. Modules without them, like Ripples and Streams, run as in standard. */
+	QUALITY_HIGH,
+	NUM_QUALITY_TIERS
+};
+
+
+/** Tier of newly added modules, saved in the plugin settings file */
+extern QualityTier defaultQualityTier;
+
+
+/** A module's tier, set from the UI thread and read by the audio thread.
+The menu and dataToJson() read `requested`, and process() calls apply() and reads `tier`, which follows the requests from its next call on.
+*/
+struct QualityTierSetting {
+	QualityTier requested = defaultQualityTier;
+	QualityTier tier = defaultQualityTier;
+	CommandQueue<QualityTier> commands;
+
+	void set(QualityTier tier) {
+		requested = tier;
+		commands.push(tier);
+	}
+
+	/** Applies the pending changes and returns the tier. Call at the top of process(). */
+	QualityTier apply() {
+		commands.drain([&](QualityTier t) {
+			tier = t;
+		});
+		return tier;
+	}
+};
+
+
+/** Returns the Speex quality of the sample rate converters at a tier. */
+inline int getSrcQuality(QualityTier tier) {
+	switch (tier) {
+		case QUALITY_ECO: return SPEEX_RESAMPLER_QUALITY_VOIP;
+		case QUALITY_HIGH: return SPEEX_RESAMPLER_QUALITY_DESKTOP;
+		default: return SPEEX_RESAMPLER_QUALITY_DEFAULT;
+	}
+}
+
+
+/** Reads a module's tier from its JSON data.
+Patches saved before the tiers existed have a "lowCpu" flag in some modules, which maps to eco.
+*/
+inline void qualityTierFromJson(json_t* rootJ, QualityTierSetting* setting) {
+	json_t* tierJ = json_object_get(rootJ, "qualityTier");
+	if (tierJ) {
+		setting->set((QualityTier) rack::math::clamp((int) json_integer_value(tierJ), 0, NUM_QUALITY_TIERS - 1));
+		return;
+	}
+	json_t* lowCpuJ = json_object_get(rootJ, "lowCpu");
+	if (lowCpuJ)
+		setting->set(json_boolean_value(lowCpuJ) ? QUALITY_ECO : QUALITY_STANDARD);
+	else
+		setting->set(QUALITY_STANDARD);
+}
+
+
+/** Adds the "Processing quality" submenu for a module's tier, and the default tier of new modules, to its context menu. */
+void appendQualityMenu(rack::ui::Menu* menu, QualityTierSetting* setting);
@@ -0,0 +1,191 @@
+#include "plugin.hpp"
+#include <chrono>
+#include <ctime>
+
+
+/** Size of the header written by writeWavHeader(), up to the start of the sample data */
+static const int HEADER_SIZE = 80;
+static const uint64_t MAX_RIFF_SIZE = 0xffffffff;
+
+
+static void putU16(uint8_t*& p, uint16_t x) {
+	for (int i = 0; i < 2; i++)
+		*p++ = x >> (8 * i);
+}
+
+static void putU32(uint8_t*& p, uint32_t x) {
+	for (int i = 0; i < 4; i++)
+		*p++ = x >> (8 * i);
+}
+
+static void putU64(uint8_t*& p, uint64_t x) {
+	for (int i = 0; i < 8; i++)
+		*p++ = x >> (8 * i);
+}
+
+static void putId(uint8_t*& p, const char* id) {
+	std::memcpy(p, id, 4);
+	p += 4;
+}
+
+
+void writeWavHeader(std::FILE* file, int channels, int sampleRate, uint64_t dataSize) {
+	uint8_t header[HEADER_SIZE] = {};
+	uint8_t* p = header;
+	uint64_t riffSize = HEADER_SIZE - 8 + dataSize;
+	bool rf64 = riffSize > MAX_RIFF_SIZE;
+
+	putId(p, rf64 ? "RF64" : "RIFF");
+	putU32(p, rf64 ? MAX_RIFF_SIZE : riffSize);
+	putId(p, "WAVE");
+
+	putId(p, rf64 ? "ds64" : "JUNK");
+	putU32(p, 28);
+	if (rf64) {
+		putU64(p, riffSize);
+		putU64(p, dataSize);
+		putU64(p, dataSize / (4 * channels));
+		putU32(p, 0);
+	}
+	else {
+		p += 28;
+	}
+
+	putId(p, "fmt ");
+	putU32(p, 16);
+	// WAVE_FORMAT_IEEE_FLOAT
+	putU16(p, 3);
+	putU16(p, channels);
+	putU32(p, sampleRate);
+	putU32(p, sampleRate * channels * 4);
+	putU16(p, channels * 4);
+	putU16(p, 32);
+
+	putId(p, "data");
+	putU32(p, rf64 ? MAX_RIFF_SIZE : dataSize);
+
+	std::fseek(file, 0, SEEK_SET);
+	std::fwrite(header, 1, HEADER_SIZE, file);
+}
+
+
+bool Recorder::start(const std::string& path, Module* module, const std::vector<int>& outputIds) {
+	stop();
+
+	numOutputs = 0;
+	channels = 0;
+	for (int id : outputIds) {
+		int outputChannels = std::max(module->outputs[id].getChannels(), 1);
+		if (channels + outputChannels > MAX_CHANNELS)
+			break;
+		this->outputIds[numOutputs] = id;
+		this->outputChannels[numOutputs] = outputChannels;
+		numOutputs++;
+		channels += outputChannels;
+	}
+	sampleRate = (int) APP->engine->getSampleRate();
+
+	file = std::fopen(path.c_str(), "wb");
+	if (!file) {
+		WARN("Could not create recording %s", path.c_str());
+		return false;
+	}
+	writeWavHeader(file, channels, sampleRate, 0);
+	this->path = path;
+
+	if (!buffer)
+		buffer = new float[BUFFER_FRAMES * MAX_CHANNELS];
+	readFrame = 0;
+	writeFrame = 0;
+	recordedFrames = 0;
+	droppedFrames = 0;
+	stopReason = STOPPED_BY_USER;
+
+	recording.store(true, std::memory_order_release);
+	writerThread = std::thread([this]() {runWriter();});
+	return true;
+}
+
+
+void Recorder::stop() {
+	if (!writerThread.joinable())
+		return;
+
+	recording.store(false);
+	// Once process() is out of its frame, it won't read the layout again until the next start()
+	while (writing.load())
+		std::this_thread::yield();
+	writerThread.join();
+
+	if (droppedFrames > 0)
+		WARN("Recording %s dropped %llu frames", path.c_str(), (unsigned long long) droppedFrames);
+}
+
+
+void Recorder::runWriter() {
+	std::vector<float> samples;
+
+	while (true) {
+		// Check for stop before reading the write position, so frames pushed before stopping are still written
+		bool stopping = !recording.load(std::memory_order_acquire);
+		size_t r = readFrame.load(std::memory_order_relaxed);
+		size_t w = writeFrame.load(std::memory_order_acquire);
+		if (r == w) {
+			if (stopping)
+				break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			continue;
+		}
+
+		// Write up to the end of the ring, where the frames stop being contiguous
+		size_t start = r & (BUFFER_FRAMES - 1);
+		size_t frames = std::min(w - r, BUFFER_FRAMES - start);
+		const float* frame = &buffer[start * channels];
+		samples.resize(frames * channels);
+		for (size_t i = 0; i < frames * channels; i++)
+			samples[i] = frame[i] / 10.f;
+		readFrame.store(r + frames, std::memory_order_release);
+
+		std::fwrite(samples.data(), sizeof(float), samples.size(), file);
+		recordedFrames += frames;
+	}
+
+	writeWavHeader(file, channels, sampleRate, recordedFrames * channels * 4);
+	std::fclose(file);
+	file = NULL;
+}
+
+
+void appendRecorderMenu(Menu* menu, Recorder* recorder, Module* module, std::vector<int> outputIds) {
+	menu->addChild(createSubmenuItem("Record outputs",
+		[=](Menu* menu) {
+			if (recorder->isRecording()) {
+				menu->addChild(createMenuLabel(string::f("Recording to %s", system::getFilename(recorder->path).c_str())));
+				menu->addChild(createMenuLabel(string::f("%.1f s written, %llu frames dropped",
+					(double) recorder->recordedFrames / recorder->sampleRate,
+					(unsigned long long) recorder->droppedFrames)));
+				menu->addChild(createMenuItem("Stop recording", "",
+					[=]() {recorder->stop();}
+				));
+			}
+			else {
+				if (recorder->stopReason == Recorder::STOPPED_BY_CHANNELS)
+					menu->addChild(createMenuLabel("Last recording ended when a channel count changed"));
+				else if (recorder->stopReason == Recorder::STOPPED_BY_SAMPLE_RATE)
+					menu->addChild(createMenuLabel("Last recording ended when the sample rate changed"));
+				menu->addChild(createMenuLabel("Ends if the channel counts or the sample rate change"));
+				menu->addChild(createMenuItem("Start recording", "",
+					[=]() {
+						std::string dir = asset::user("AudibleInstruments/recordings");
+						system::createDirectories(dir);
+
+						char date[32];
+						std::time_t t = std::time(NULL);
+						std::strftime(date, sizeof(date), "%Y%m%d-%H%M%S", std::localtime(&t));
+						recorder->start(system::join(dir, module->model->slug + "-" + date + ".wav"), module, outputIds);
+					}
+				));
+			}
+		}
+	));
+}
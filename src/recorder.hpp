@@ -0,0 +1,140 @@
+#pragma once
+
+#include <rack.hpp>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/** Writes the header of a 32-bit float WAV file with `dataSize` bytes of samples, at the start of the file, leaving the file positioned at the samples.
+A JUNK chunk reserves room for an RF64 ds64 chunk, which replaces it if the data is too large for RIFF.
+So a recording can write a header for 0 bytes first, and rewrite it with the final size when done.
+*/
+void writeWavHeader(std::FILE* file, int channels, int sampleRate, uint64_t dataSize);
+
+
+/** Streams some of a module's outputs to a 32-bit float WAV file while the module runs.
+
+process() copies each frame of output voltages into a lock-free ring buffer, and a background thread writes the buffer to disk, so the audio thread never blocks or allocates.
+Channels are interleaved in the order of the outputs, and ±10 V is full scale.
+Files that grow past 4 GB are finalized as RF64.
+Frames that arrive while the ring buffer is full are dropped and counted in droppedFrames.
+The channel counts and the sample rate are fixed when recording starts. If any of them changes, process() ends the recording, so the file never mixes layouts or is labeled with the wrong rate.
+
+start() and stop() are called from the UI thread, and process() from the audio thread.
+*/
+struct Recorder {
+	static constexpr int MAX_CHANNELS = 32;
+	/** Frames the ring buffer holds, about 1.4 seconds at 48 kHz */
+	static constexpr size_t BUFFER_FRAMES = 1 << 16;
+
+	enum StopReason {
+		STOPPED_BY_USER,
+		STOPPED_BY_CHANNELS,
+		STOPPED_BY_SAMPLE_RATE,
+	};
+
+	/** Interleaved frames, allocated by the first start() with room for MAX_CHANNELS */
+	float* buffer = NULL;
+	std::atomic<size_t> writeFrame{0};
+	std::atomic<size_t> readFrame{0};
+	std::atomic<bool> recording{false};
+	/** Set by process() while it reads the fields below for a frame. stop() waits for it to clear before start() can rewrite them. */
+	std::atomic<bool> writing{false};
+	/** Why the last recording ended */
+	std::atomic<int> stopReason{STOPPED_BY_USER};
+
+	/** The outputs that make up a frame, and how many of their channels are recorded. Fixed when recording starts. */
+	int outputIds[MAX_CHANNELS] = {};
+	int outputChannels[MAX_CHANNELS] = {};
+	int numOutputs = 0;
+	int channels = 0;
+	int sampleRate = 0;
+
+	/** Frames written to the file so far */
+	std::atomic<uint64_t> recordedFrames{0};
+	/** Frames lost because the writer thread fell behind */
+	std::atomic<uint64_t> droppedFrames{0};
+
+	std::string path;
+	std::FILE* file = NULL;
+	std::thread writerThread;
+
+	Recorder() {}
+	~Recorder() {
+		stop();
+		delete[] buffer;
+	}
+
+	Recorder(const Recorder&) = delete;
+	Recorder& operator=(const Recorder&) = delete;
+
+	/** Whether frames are being recorded. False as soon as process() ends a recording, even before its file is finalized. */
+	bool isRecording() {
+		return recording.load(std::memory_order_relaxed);
+	}
+
+	/** Starts recording the current channels of the given outputs to a new file at `path`, stopping any recording in progress.
+	Returns false if the file can't be created.
+	*/
+	bool start(const std::string& path, rack::engine::Module* module, const std::vector<int>& outputIds);
+	/** Stops recording, waits for process() to finish any frame it is copying and for the writer thread to flush the buffer and finalize the file's header. */
+	void stop();
+
+	/** Appends the current voltages of the recorded outputs. Call at the end of process(), after the outputs are set. */
+	void process(rack::engine::Module* module, float sampleRate) {
+		if (!recording.load(std::memory_order_relaxed))
+			return;
+
+		// Sequentially consistent, so either stop() sees `writing` and waits, or this sees that recording stopped
+		writing.store(true);
+		if (recording.load())
+			pushFrame(module, sampleRate);
+		writing.store(false, std::memory_order_release);
+	}
+
+	void pushFrame(rack::engine::Module* module, float sampleRate) {
+		if ((int) sampleRate != this->sampleRate) {
+			end(STOPPED_BY_SAMPLE_RATE);
+			return;
+		}
+		for (int i = 0; i < numOutputs; i++) {
+			if (std::max(module->outputs[outputIds[i]].getChannels(), 1) != outputChannels[i]) {
+				end(STOPPED_BY_CHANNELS);
+				return;
+			}
+		}
+
+		size_t w = writeFrame.load(std::memory_order_relaxed);
+		if (w - readFrame.load(std::memory_order_acquire) >= BUFFER_FRAMES) {
+			droppedFrames.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		float* frame = &buffer[(w & (BUFFER_FRAMES - 1)) * channels];
+		for (int i = 0; i < numOutputs; i++) {
+			std::memcpy(frame, module->outputs[outputIds[i]].voltages, outputChannels[i] * sizeof(float));
+			frame += outputChannels[i];
+		}
+		writeFrame.store(w + 1, std::memory_order_release);
+	}
+
+	/** Ends the recording from the audio thread. The writer thread flushes the buffer and finalizes the file, and the next stop() or start() joins it. */
+	void end(StopReason reason) {
+		stopReason.store(reason, std::memory_order_relaxed);
+		recording.store(false, std::memory_order_release);
+	}
+
+	/** Body of the writer thread, which also finalizes the file once recording stops */
+	void runWriter();
+};
+
+
+/** Adds the "Record outputs" submenu to a module's context menu.
+Recordings go to the "AudibleInstruments/recordings" folder in the Rack user folder, named after the module and the time they started.
+*/
+void appendRecorderMenu(rack::ui::Menu* menu, Recorder* recorder, rack::engine::Module* module, std::vector<int> outputIds);
@@ -0,0 +1,46 @@
+#include "plugin.hpp"
+
+
+static std::string getSettingsPath() {
+	return asset::user("AudibleInstruments.json");
+}
+
+
+void loadPluginSettings() {
+	FILE* file = std::fopen(getSettingsPath().c_str(), "r");
+	if (!file)
+		return;
+	DEFER({std::fclose(file);});
+
+	json_error_t error;
+	json_t* rootJ = json_loadf(file, 0, &error);
+	if (!rootJ) {
+		WARN("Could not parse %s: %s", getSettingsPath().c_str(), error.text);
+		return;
+	}
+	DEFER({json_decref(rootJ);});
+
+	json_t* budgetJ = json_object_get(rootJ, "cpuBudget");
+	if (budgetJ)
+		governor.budget = json_number_value(budgetJ);
+
+	json_t* qualityTierJ = json_object_get(rootJ, "defaultQualityTier");
+	if (qualityTierJ)
+		defaultQualityTier = (QualityTier) clamp((int) json_integer_value(qualityTierJ), 0, NUM_QUALITY_TIERS - 1);
+}
+
+
+void savePluginSettings() {
+	json_t* rootJ = json_object();
+	DEFER({json_decref(rootJ);});
+	json_object_set_new(rootJ, "cpuBudget", json_real(governor.budget));
+	json_object_set_new(rootJ, "defaultQualityTier", json_integer(defaultQualityTier));
+
+	FILE* file = std::fopen(getSettingsPath().c_str(), "w");
+	if (!file) {
+		WARN("Could not write %s", getSettingsPath().c_str());
+		return;
+	}
+	DEFER({std::fclose(file);});
+	json_dumpf(rootJ, file, JSON_INDENT(2));
+}
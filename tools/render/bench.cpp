@@ -0,0 +1,1188 @@
+// Cost matrix for Plaits engines and Braids shapes.
+//
+// Each engine or shape is rendered in isolation by a fresh monophonic module instance.
+// Its timbre params are swept across their range during the render, and the trigger input is pulsed every 250 ms so percussive engines do their full work.
+// Time is measured over chunks of CHUNK_FRAMES samples, a multiple of both modules' internal block sizes, so the spread between chunks reflects the DSP and not block boundaries.
+//
+// The latency mode does the opposite: it times every process() call on its own, because block-based modules do almost nothing on most samples and all of their work on one.
+// The slowest calls, not the mean, decide whether the audio thread misses its deadline.
+//
+// The denormal mode checks that silence costs the same throughout. After a loud burst, feedback state in filters, resonators and reverbs decays towards zero.
+// If it reaches the denormal range, every operation on it becomes many times slower on x86, so the cost rises long after the input went quiet.
+//
+// The ripples mode compares the two Ripples filter solvers on the bare engine: their cost, their LP4 response and the pitch of self-oscillation.
+// Both are compared with RK2 running at 16 times the rate, which stands in for the analog circuit.
+//
+// The additive mode compares the float_4 harmonic oscillator that Plaits' harmonic engine renders with against the firmware's scalar Chebyshev recurrence.
+//
+// The wavetable mode reads Plaits' wavetables from their full-size tables and from their mip-mapped copies, and measures how much of each output is aliasing.
+//
+// The correlator mode times the splice search of Clouds' WSOLA player against a copy of the firmware's, on sign bits with a known best match.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench.hpp"
+#include "braids/macro_oscillator.h"
+#include "../../src/Ripples/ripples.hpp"
+#include "../../src/Plaits/plaits/dsp/oscillator/harmonic_oscillator.h"
+#include "wavetable.hpp"
+#include "../../src/prng.hpp"
+#include "clouds/dsp/correlator.h"
+
+
+using clock_type = std::chrono::steady_clock;
+
+static constexpr int CHUNK_FRAMES = 240;
+
+
+struct BenchCase {
+	std::string model;
+	std::string label;
+	/** Selects the engine or shape on a newly created module */
+	std::function<void(engine::Module*)> select;
+	/** Names of the params swept during the render */
+	std::vector<std::string> sweep;
+};
+
+
+struct BenchResult {
+	/** Per-chunk nanoseconds per sample */
+	double mean = 0.0;
+	double stdDev = 0.0;
+	double worst = 0.0;
+};
+
+
+static plugin::Model* findModel(plugin::Plugin* p, const std::string& slug) {
+	for (plugin::Model* model : p->models) {
+		if (model->slug == slug)
+			return model;
+	}
+	return NULL;
+}
+
+
+static int findParam(engine::Module* module, const std::string& name) {
+	for (size_t i = 0; i < module->paramQuantities.size(); i++) {
+		if (module->paramQuantities[i] && module->paramQuantities[i]->name == name)
+			return i;
+	}
+	return -1;
+}
+
+
+static int findInput(engine::Module* module, const std::string& name) {
+	for (size_t i = 0; i < module->inputInfos.size(); i++) {
+		if (module->inputInfos[i] && module->inputInfos[i]->name == name)
+			return i;
+	}
+	return -1;
+}
+
+
+/** Marks every output as connected and pulses the trigger input if there is one. */
+static int prepareModule(engine::Module* module) {
+	// Modules skip work for outputs that aren't connected
+	for (engine::Output& output : module->outputs)
+		output.channels = 1;
+	int triggerId = findInput(module, "Trigger");
+	if (triggerId >= 0)
+		module->inputs[triggerId].channels = 1;
+	return triggerId;
+}
+
+
+static std::vector<BenchCase> getCases(const std::string& target) {
+	std::vector<BenchCase> cases;
+
+	if (target == "plaits" || target == "all") {
+		for (int engineId = 0; engineId < 16; engineId++) {
+			BenchCase bc;
+			bc.model = "Plaits";
+			bc.label = string::f("engine %d", engineId);
+			bc.select = [=](engine::Module* module) {
+				json_t* rootJ = json_object();
+				json_object_set_new(rootJ, "model", json_integer(engineId));
+				module->dataFromJson(rootJ);
+				json_decref(rootJ);
+			};
+			bc.sweep = {"Harmonics", "Timbre", "Morph"};
+			cases.push_back(bc);
+		}
+	}
+
+	if (target == "braids" || target == "all") {
+		const int lastShape = braids::MACRO_OSC_SHAPE_LAST_ACCESSIBLE_FROM_META;
+		for (int shape = 0; shape <= lastShape; shape++) {
+			BenchCase bc;
+			bc.model = "Braids";
+			bc.label = string::f("shape %d", shape);
+			bc.select = [=](engine::Module* module) {
+				int paramId = findParam(module, "Model");
+				if (paramId >= 0)
+					module->params[paramId].setValue(shape / (float) lastShape);
+			};
+			bc.sweep = {"Timbre", "Color"};
+			cases.push_back(bc);
+		}
+	}
+
+	return cases;
+}
+
+
+static bool runCase(plugin::Plugin* p, const BenchCase& bc, float duration, float sampleRate, BenchResult& result) {
+	plugin::Model* model = findModel(p, bc.model);
+	if (!model) {
+		std::fprintf(stderr, "Unknown model %s\n", bc.model.c_str());
+		return false;
+	}
+
+	engine::Module* module = model->createModule();
+	DEFER({delete module;});
+	engine::Module::AddEvent eAdd;
+	module->onAdd(eAdd);
+	bc.select(module);
+
+	int triggerId = prepareModule(module);
+	std::vector<engine::ParamQuantity*> sweep;
+	for (const std::string& name : bc.sweep) {
+		int paramId = findParam(module, name);
+		if (paramId >= 0)
+			sweep.push_back(module->paramQuantities[paramId]);
+	}
+
+	engine::Module::ProcessArgs args;
+	args.sampleRate = sampleRate;
+	args.sampleTime = 1.f / sampleRate;
+	args.frame = 0;
+	int64_t triggerPeriod = std::max<int64_t>(sampleRate / 4, 2);
+	auto step = [&]() {
+		float gate = (args.frame % triggerPeriod < triggerPeriod / 2) ? 10.f : 0.f;
+		for (int inputId : gateIds)
+			module->inputs[inputId].setVoltage(gate);
+		module->process(args);
+		args.frame++;
+	};
+
+	// Let engine switches and buffers settle before timing
+	int64_t warmupFrames = (int64_t) (0.1f * sampleRate);
+	for (int64_t i = 0; i < warmupFrames; i++)
+		step();
+
+	int64_t chunks = std::max<int64_t>((int64_t) (duration * sampleRate) / CHUNK_FRAMES, 1);
+	std::vector<double> times(chunks);
+	for (int64_t c = 0; c < chunks; c++) {
+		// Sweep each param over its range at a different rate, so the combinations are well covered
+		float t = (float) c / chunks;
+		for (size_t i = 0; i < sweep.size(); i++)
+			sweep[i]->setScaledValue(0.5f - 0.5f * std::cos(2.f * M_PI * t * (i + 1)));
+
+		clock_type::time_point start = clock_type::now();
+		for (int i = 0; i < CHUNK_FRAMES; i++)
+			step();
+		times[c] = std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / CHUNK_FRAMES;
+	}
+
+	double sum = 0.0;
+	for (double time : times)
+		sum += time;
+	result.mean = sum / chunks;
+	double variance = 0.0;
+	for (double time : times)
+		variance += (time - result.mean) * (time - result.mean);
+	result.stdDev = std::sqrt(variance / chunks);
+	result.worst = *std::max_element(times.begin(), times.end());
+	return true;
+}
+
+
+int bench(plugin::Plugin* p, const std::string& target, float duration, float sampleRate, const std::string& csvPath) {
+	std::vector<BenchCase> cases = getCases(target);
+	if (cases.empty()) {
+		std::fprintf(stderr, "Unknown benchmark %s\n", target.c_str());
+		return 1;
+	}
+
+	FILE* csv = NULL;
+	if (!csvPath.empty()) {
+		csv = std::fopen(csvPath.c_str(), "w");
+		if (!csv) {
+			std::fprintf(stderr, "Could not write %s\n", csvPath.c_str());
+			return 1;
+		}
+		std::fprintf(csv, "model,case,ns_per_sample,std_dev,worst,percent_dsp_16_voices\n");
+	}
+	DEFER({
+		if (csv)
+			std::fclose(csv);
+	});
+
+	// Share of the sample period that 16 voices would take
+	double periodNs = 1e9 / sampleRate;
+	std::printf("%-8s %-10s %10s %10s %10s %10s\n", "Model", "Case", "ns/sample", "Std dev", "Worst", "16x % DSP");
+	for (const BenchCase& bc : cases) {
+		BenchResult result;
+		if (!runCase(p, bc, duration, sampleRate, result))
+			return 1;
+		double percent16 = result.mean * 16 / periodNs * 100.0;
+		std::printf("%-8s %-10s %10.1f %10.1f %10.1f %10.1f\n", bc.model.c_str(), bc.label.c_str(), result.mean, result.stdDev, result.worst, percent16);
+		if (csv)
+			std::fprintf(csv, "%s,%s,%.1f,%.1f,%.1f,%.2f\n", bc.model.c_str(), bc.label.c_str(), result.mean, result.stdDev, result.worst, percent16);
+	}
+	return 0;
+}
+
+
+struct LatencyCase {
+	std::string model;
+	int channels;
+	bool spread;
+};
+
+
+struct BlockModel {
+	std::string model;
+	/** Input whose channel count sets the polyphony, or empty if the module is monophonic */
+	std::string polyInput;
+	/** Inputs that receive a gate, so the module is excited and does its full work */
+	std::vector<std::string> gateInputs;
+};
+
+
+static const std::vector<BlockModel> blockModels = {
+	{"Plaits", "Pitch (1V/oct)", {"Trigger"}},
+	{"Rings", "", {"Strum"}},
+	{"Clouds", "", {}},
+	{"Warps", "", {"Carrier", "Modulator"}},
+	{"Elements", "Pitch (1V/oct)", {"Gate"}},
+};
+
+
+static bool hasSpreadOption(engine::Module* module) {
+	json_t* rootJ = module->dataToJson();
+	if (!rootJ)
+		return false;
+	bool has = json_object_get(rootJ, "spreadRender");
+	json_decref(rootJ);
+	return has;
+}
+
+
+static bool runLatencyCase(plugin::Plugin* p, const LatencyCase& lc, const BlockModel& bm, float duration, float sampleRate, std::vector<double>& times) {
+	plugin::Model* model = findModel(p, lc.model);
+	if (!model) {
+		std::fprintf(stderr, "Unknown model %s\n", lc.model.c_str());
+		return false;
+	}
+
+	engine::Module* module = model->createModule();
+	DEFER({delete module;});
+	engine::Module::AddEvent eAdd;
+	module->onAdd(eAdd);
+	if (lc.spread) {
+		json_t* rootJ = json_object();
+		json_object_set_new(rootJ, "spreadRender", json_true());
+		module->dataFromJson(rootJ);
+		json_decref(rootJ);
+	}
+
+	prepareModule(module);
+	if (!bm.polyInput.empty()) {
+		int inputId = findInput(module, bm.polyInput);
+		if (inputId >= 0)
+			module->inputs[inputId].channels = lc.channels;
+	}
+	std::vector<int> gateIds;
+	for (const std::string& name : bm.gateInputs) {
+		int inputId = findInput(module, name);
+		if (inputId < 0) {
+			std::fprintf(stderr, "%s has no %s input\n", lc.model.c_str(), name.c_str());
+			return false;
+		}
+		module->inputs[inputId].channels = 1;
+		gateIds.push_back(inputId);
+	}
+
+	engine::Module::ProcessArgs args;
+	args.sampleRate = sampleRate;
+	args.sampleTime = 1.f / sampleRate;
+	args.frame = 0;
+	int64_t triggerPeriod = std::max<int64_t>(sampleRate / 4, 2);
+	auto step = [&]() {
+		if (triggerId >= 0)
+			module->inputs[triggerId].setVoltage((args.frame % triggerPeriod < triggerPeriod / 2) ? 10.f : 0.f);
+		module->process(args);
+		args.frame++;
+	};
+
+	int64_t warmupFrames = (int64_t) (0.1f * sampleRate);
+	for (int64_t i = 0; i < warmupFrames; i++)
+		step();
+
+	int64_t frames = std::max<int64_t>((int64_t) (duration * sampleRate), 1);
+	times.resize(frames);
+	for (int64_t i = 0; i < frames; i++) {
+		clock_type::time_point start = clock_type::now();
+		step();
+		times[i] = std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+	}
+	return true;
+}
+
+
+/** Returns the value below which a fraction `q` of the sorted `times` fall. */
+static double percentile(const std::vector<double>& times, double q) {
+	size_t i = std::min<size_t>((size_t) (q * times.size()), times.size() - 1);
+	return times[i];
+}
+
+
+int latency(plugin::Plugin* p, const std::string& target, float duration, float sampleRate, const std::string& csvPath) {
+	std::vector<std::pair<LatencyCase, const BlockModel*>> cases;
+	for (const BlockModel& bm : blockModels) {
+		if (target != "blocks" && target != bm.model)
+			continue;
+		std::vector<int> channelCounts = {1};
+		if (!bm.polyInput.empty())
+			channelCounts = {1, 4, 16};
+
+		// Only offer the spread variant if the module has the option
+		bool spreadable = false;
+		plugin::Model* model = findModel(p, bm.model);
+		if (model) {
+			engine::Module* module = model->createModule();
+			spreadable = hasSpreadOption(module);
+			delete module;
+		}
+
+		for (int channels : channelCounts) {
+			cases.push_back({{bm.model, channels, false}, &bm});
+			if (spreadable)
+				cases.push_back({{bm.model, channels, true}, &bm});
+		}
+	}
+	if (cases.empty()) {
+		std::fprintf(stderr, "Unknown latency benchmark %s\n", target.c_str());
+		return 1;
+	}
+
+	FILE* csv = NULL;
+	if (!csvPath.empty()) {
+		csv = std::fopen(csvPath.c_str(), "w");
+		if (!csv) {
+			std::fprintf(stderr, "Could not write %s\n", csvPath.c_str());
+			return 1;
+		}
+		std::fprintf(csv, "model,channels,spread,p50,p99,p99_9,max\n");
+	}
+	DEFER({
+		if (csv)
+			std::fclose(csv);
+	});
+
+	std::printf("%-8s %8s %6s %10s %10s %10s %10s\n", "Model", "Channels", "Spread", "p50 ns", "p99 ns", "p99.9 ns", "Max ns");
+	for (const auto& it : cases) {
+		const LatencyCase& lc = it.first;
+		std::vector<double> times;
+		if (!runLatencyCase(p, lc, *it.second, duration, sampleRate, times))
+			return 1;
+		std::sort(times.begin(), times.end());
+		double p50 = percentile(times, 0.5);
+		double p99 = percentile(times, 0.99);
+		double p999 = percentile(times, 0.999);
+		double max = times.back();
+		std::printf("%-8s %8d %6s %10.0f %10.0f %10.0f %10.0f\n", lc.model.c_str(), lc.channels, lc.spread ? "on" : "off", p50, p99, p999, max);
+		if (csv)
+			std::fprintf(csv, "%s,%d,%d,%.0f,%.0f,%.0f,%.0f\n", lc.model.c_str(), lc.channels, lc.spread, p50, p99, p999, max);
+	}
+	return 0;
+}
+
+
+struct DenormalCase {
+	std::string model;
+	/** Inputs that receive the burst */
+	std::vector<std::string> inputs;
+	/** Params set before the burst, so feedback paths have long tails */
+	std::vector<std::pair<std::string, float>> params;
+};
+
+
+static const std::vector<DenormalCase> denormalCases = {
+	{"Rings", {"Audio"}, {}},
+	{"Elements", {"External blow", "External strike"}, {}},
+	{"Clouds", {"Left", "Right"}, {{"Feedback amount", 0.5f}, {"Reverb amount", 0.7f}}},
+	{"Ripples", {"Audio"}, {{"Resonance", 0.8f}}},
+	{"Shelves", {"Audio"}, {}},
+};
+
+
+/** Length of the stretches of silence whose mean costs are compared, in seconds */
+static constexpr float DENORMAL_WINDOW = 0.25f;
+/** Largest allowed ratio of the slowest stretch to the median one */
+static constexpr double DENORMAL_MAX_RATIO = 2.0;
+
+
+int denormal(plugin::Plugin* p, float duration, float sampleRate, const std::string& csvPath) {
+	FILE* csv = NULL;
+	if (!csvPath.empty()) {
+		csv = std::fopen(csvPath.c_str(), "w");
+		if (!csv) {
+			std::fprintf(stderr, "Could not write %s\n", csvPath.c_str());
+			return 1;
+		}
+		std::fprintf(csv, "model,burst,silence_median,silence_worst,ratio\n");
+	}
+	DEFER({
+		if (csv)
+			std::fclose(csv);
+	});
+
+	int exitCode = 0;
+	std::printf("%-8s %10s %10s %10s %8s\n", "Model", "Burst ns", "Median ns", "Worst ns", "Ratio");
+	for (const DenormalCase& dc : denormalCases) {
+		plugin::Model* model = findModel(p, dc.model);
+		if (!model) {
+			std::fprintf(stderr, "Unknown model %s\n", dc.model.c_str());
+			return 1;
+		}
+
+		engine::Module* module = model->createModule();
+		DEFER({delete module;});
+		engine::Module::AddEvent eAdd;
+		module->onAdd(eAdd);
+		prepareModule(module);
+		for (const auto& it : dc.params) {
+			int paramId = findParam(module, it.first);
+			if (paramId >= 0)
+				module->paramQuantities[paramId]->setScaledValue(it.second);
+		}
+		std::vector<int> inputIds;
+		for (const std::string& name : dc.inputs) {
+			int inputId = findInput(module, name);
+			if (inputId >= 0) {
+				module->inputs[inputId].channels = 1;
+				inputIds.push_back(inputId);
+			}
+		}
+
+		engine::Module::ProcessArgs args;
+		args.sampleRate = sampleRate;
+		args.sampleTime = 1.f / sampleRate;
+		args.frame = 0;
+
+		// Half a second of full-scale white noise
+		uint32_t seed = 1;
+		int64_t burstChunks = std::max<int64_t>((int64_t) (0.5f * sampleRate) / CHUNK_FRAMES, 1);
+		clock_type::time_point start = clock_type::now();
+		for (int64_t i = 0; i < burstChunks * CHUNK_FRAMES; i++) {
+			for (int inputId : inputIds) {
+				seed = seed * 1664525 + 1013904223;
+				module->inputs[inputId].setVoltage((seed >> 8) * (20.f / 16777216.f) - 10.f);
+			}
+			module->process(args);
+			args.frame++;
+		}
+		double burst = std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / (burstChunks * CHUNK_FRAMES);
+
+		// Silence, timed in windows
+		for (int inputId : inputIds)
+			module->inputs[inputId].setVoltage(0.f);
+		int64_t windowChunks = std::max<int64_t>((int64_t) (DENORMAL_WINDOW * sampleRate) / CHUNK_FRAMES, 1);
+		int64_t windows = std::max<int64_t>((int64_t) (duration / DENORMAL_WINDOW), 1);
+		std::vector<double> times(windows);
+		for (int64_t w = 0; w < windows; w++) {
+			start = clock_type::now();
+			for (int64_t i = 0; i < windowChunks * CHUNK_FRAMES; i++) {
+				module->process(args);
+				args.frame++;
+			}
+			times[w] = std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / (windowChunks * CHUNK_FRAMES);
+		}
+
+		std::sort(times.begin(), times.end());
+		double median = times[windows / 2];
+		double worst = times.back();
+		double ratio = worst / median;
+		bool flat = ratio <= DENORMAL_MAX_RATIO;
+		if (!flat)
+			exitCode = 1;
+		std::printf("%-8s %10.1f %10.1f %10.1f %8.2f%s\n", dc.model.c_str(), burst, median, worst, ratio, flat ? "" : "  NOT FLAT");
+		if (csv)
+			std::fprintf(csv, "%s,%.1f,%.1f,%.1f,%.3f\n", dc.model.c_str(), burst, median, worst, ratio);
+	}
+	return exitCode;
+}
+
+
+/** Sample rate of the reference Ripples engine, as a multiple of the bench rate.
+At 16x, the RK2 solver runs at 700 kHz or more, where its error is negligible.
+*/
+static constexpr int RIPPLES_REFERENCE_RATIO = 16;
+/** Responses are only compared where the reference LP4 gain is above this, so the deep stopband near Nyquist doesn't dominate */
+static constexpr double RIPPLES_RESPONSE_FLOOR = -24.0;
+/** Largest allowed deviations of the implicit solver from the reference.
+At 48 kHz, RK2 itself is off by up to 0.9 dB and 50 cents. The implicit solver's frequency warping makes the top octave up to about 1.1 dB brighter at the highest cutoffs.
+*/
+static constexpr double RIPPLES_MAX_DB = 1.5;
+static constexpr double RIPPLES_MAX_CENTS = 5.0;
+
+static const std::vector<float> ripplesCutoffs = {500.f, 2000.f, 5000.f, 10000.f, 14000.f};
+
+
+/** Returns the frequency knob position for a nominal cutoff in Hz. */
+static float ripplesKnob(float cutoff) {
+	return std::log(cutoff / ripples::kFreqKnobMin) / std::log(ripples::kFreqKnobMax / ripples::kFreqKnobMin);
+}
+
+
+/** Returns the cost of one channel in ns/sample, filtering a 110 Hz square wave with some resonance. */
+static double ripplesCost(ripples::RipplesEngine::Solver solver, float sampleRate, float cutoff, float duration) {
+	ripples::RipplesEngine engine;
+	engine.setSampleRate(sampleRate);
+	engine.setSolver(solver);
+	ripples::RipplesEngine::Frame frame = {};
+	frame.res_knob = 0.7f;
+	frame.freq_knob = ripplesKnob(cutoff);
+
+	int64_t period = std::max<int64_t>(sampleRate / 110, 2);
+	int64_t warmupFrames = (int64_t) (0.1f * sampleRate);
+	int64_t frames = std::max<int64_t>((int64_t) (duration * sampleRate), 1);
+	float out = 0.f;
+	clock_type::time_point start;
+	for (int64_t i = 0; i < warmupFrames + frames; i++) {
+		if (i == warmupFrames)
+			start = clock_type::now();
+		frame.input = (i % period < period / 2) ? 5.f : -5.f;
+		engine.process(frame);
+		out += frame.lp4;
+	}
+	double ns = std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / frames;
+	// Keep the output alive so the loop isn't optimized away
+	if (out == 1e30f)
+		std::printf(" ");
+	return ns;
+}
+
+
+/** Returns the LP4 gain in dB for a sine wave at `freq`. */
+static double ripplesGain(ripples::RipplesEngine::Solver solver, float sampleRate, float cutoff, float resonance, float freq) {
+	ripples::RipplesEngine engine;
+	engine.setSampleRate(sampleRate);
+	engine.setSolver(solver);
+	ripples::RipplesEngine::Frame frame = {};
+	frame.res_knob = resonance;
+	frame.freq_knob = ripplesKnob(cutoff);
+
+	// Small enough to keep the core linear
+	const float amplitude = 0.1f;
+	int64_t settleFrames = (int64_t) (0.1f * sampleRate);
+	int64_t frames = (int64_t) (0.1f * sampleRate);
+	double in = 0.0;
+	double out = 0.0;
+	for (int64_t i = 0; i < settleFrames + frames; i++) {
+		frame.input = amplitude * std::sin(2.0 * M_PI * freq * i / sampleRate);
+		engine.process(frame);
+		if (i >= settleFrames) {
+			in += frame.input * frame.input;
+			out += frame.lp4 * frame.lp4;
+		}
+	}
+	return 10.0 * std::log10(out / in);
+}
+
+
+/** Returns the frequency of self-oscillation at full resonance in Hz, or 0 if the filter doesn't oscillate. */
+static double ripplesPitch(ripples::RipplesEngine::Solver solver, float sampleRate, float cutoff) {
+	ripples::RipplesEngine engine;
+	engine.setSampleRate(sampleRate);
+	engine.setSolver(solver);
+	ripples::RipplesEngine::Frame frame = {};
+	frame.res_knob = 1.f;
+	frame.freq_knob = ripplesKnob(cutoff);
+
+	// Count upward zero crossings after the oscillation has built up, interpolating between samples
+	int64_t settleFrames = (int64_t) (0.5f * sampleRate);
+	int64_t frames = (int64_t) (1.f * sampleRate);
+	float last = 0.f;
+	double first = -1.0;
+	double latest = 0.0;
+	int crossings = 0;
+	for (int64_t i = 0; i < settleFrames + frames; i++) {
+		engine.process(frame);
+		float y = frame.lp4;
+		if (i > settleFrames && last < 0.f && y >= 0.f) {
+			double t = i - 1 + last / (last - y);
+			if (first < 0.0)
+				first = t;
+			latest = t;
+			crossings++;
+		}
+		last = y;
+	}
+	if (crossings < 2)
+		return 0.0;
+	return (crossings - 1) / (latest - first) * sampleRate;
+}
+
+
+static double cents(double freq, double reference) {
+	return (freq > 0.0 && reference > 0.0) ? 1200.0 * std::log2(freq / reference) : NAN;
+}
+
+
+int ripplesSolvers(float duration, float sampleRate, const std::string& csvPath) {
+	const ripples::RipplesEngine::Solver RK2 = ripples::RipplesEngine::SOLVER_RK2;
+	const ripples::RipplesEngine::Solver IMPLICIT = ripples::RipplesEngine::SOLVER_IMPLICIT;
+	float referenceRate = sampleRate * RIPPLES_REFERENCE_RATIO;
+
+	FILE* csv = NULL;
+	if (!csvPath.empty()) {
+		csv = std::fopen(csvPath.c_str(), "w");
+		if (!csv) {
+			std::fprintf(stderr, "Could not write %s\n", csvPath.c_str());
+			return 1;
+		}
+		std::fprintf(csv, "measure,cutoff,resonance,rk2,implicit,implicit_vs_rk2\n");
+	}
+	DEFER({
+		if (csv)
+			std::fclose(csv);
+	});
+
+	int exitCode = 0;
+
+	std::printf("CPU, ns/sample per channel\n");
+	std::printf("%8s %10s %10s %8s\n", "Cutoff", "RK2", "Implicit", "Saving");
+	for (float cutoff : ripplesCutoffs) {
+		double rk2 = ripplesCost(RK2, sampleRate, cutoff, duration);
+		double implicit = ripplesCost(IMPLICIT, sampleRate, cutoff, duration);
+		double saving = 100.0 * (1.0 - implicit / rk2);
+		std::printf("%8.0f %10.1f %10.1f %7.1f%%\n", cutoff, rk2, implicit, saving);
+		if (csv)
+			std::fprintf(csv, "cpu_ns,%.0f,0.7,%.1f,%.1f,%.1f\n", cutoff, rk2, implicit, saving);
+	}
+
+	std::printf("\nLP4 response, worst deviation in dB from RK2 at %gx the rate, where its gain is above %g dB\n", (double) RIPPLES_REFERENCE_RATIO, RIPPLES_RESPONSE_FLOOR);
+	std::printf("%8s %6s %10s %10s %10s\n", "Cutoff", "Res", "RK2", "Implicit", "Imp-RK2");
+	for (float cutoff : ripplesCutoffs) {
+		for (float resonance : {0.f, 0.5f}) {
+			double rk2 = 0.0;
+			double implicit = 0.0;
+			double difference = 0.0;
+			// Half-octave steps up to 16 kHz
+			for (float freq = 50.f; freq <= 16000.f; freq *= std::sqrt(2.f)) {
+				double reference = ripplesGain(RK2, referenceRate, cutoff, resonance, freq);
+				if (reference < RIPPLES_RESPONSE_FLOOR)
+					continue;
+				double a = ripplesGain(RK2, sampleRate, cutoff, resonance, freq);
+				double b = ripplesGain(IMPLICIT, sampleRate, cutoff, resonance, freq);
+				rk2 = std::max(rk2, std::fabs(a - reference));
+				implicit = std::max(implicit, std::fabs(b - reference));
+				difference = std::max(difference, std::fabs(b - a));
+			}
+			bool ok = implicit <= RIPPLES_MAX_DB;
+			if (!ok)
+				exitCode = 1;
+			std::printf("%8.0f %6.1f %10.2f %10.2f %10.2f%s\n", cutoff, resonance, rk2, implicit, difference, ok ? "" : "  INACCURATE");
+			if (csv)
+				std::fprintf(csv, "response_db,%.0f,%.1f,%.3f,%.3f,%.3f\n", cutoff, resonance, rk2, implicit, difference);
+		}
+	}
+
+	std::printf("\nSelf-oscillation pitch, cents from RK2 at %gx the rate\n", (double) RIPPLES_REFERENCE_RATIO);
+	std::printf("%8s %12s %10s %10s %10s\n", "Cutoff", "Reference", "RK2", "Implicit", "Imp-RK2");
+	for (float cutoff : ripplesCutoffs) {
+		double reference = ripplesPitch(RK2, referenceRate, cutoff);
+		double rk2 = ripplesPitch(RK2, sampleRate, cutoff);
+		double implicit = ripplesPitch(IMPLICIT, sampleRate, cutoff);
+		bool ok = std::fabs(cents(implicit, reference)) <= RIPPLES_MAX_CENTS;
+		if (!ok)
+			exitCode = 1;
+		std::printf("%8.0f %9.1f Hz %10.1f %10.1f %10.1f%s\n", cutoff, reference, cents(rk2, reference), cents(implicit, reference), cents(implicit, rk2), ok ? "" : "  INACCURATE");
+		if (csv)
+			std::fprintf(csv, "pitch_cents,%.0f,1.0,%.2f,%.2f,%.2f\n", cutoff, cents(rk2, reference), cents(implicit, reference), cents(implicit, rk2));
+	}
+	return exitCode;
+}
+
+
+/** Number of partials in each oscillator of Plaits' harmonic engine */
+static constexpr int ADDITIVE_BATCH = 12;
+/** Largest allowed difference of the float_4 oscillator from the exact sum, with the amplitudes normalized to a sum of 1 like the engine's.
+The firmware's recurrence, started from its sine table, is off by up to about 1e-4, so the difference between the two is mostly its error.
+*/
+static constexpr double ADDITIVE_MAX_ERROR = 1e-5;
+
+static const std::vector<float> additiveFrequencies = {55.f, 220.f, 880.f, 3520.f};
+
+
+/** The firmware's harmonic oscillator: cos(n theta) from cos(theta) with the Chebyshev recurrence, and the sine from a 1024-point table. */
+struct ScalarHarmonicOscillator {
+	float phase = 0.f;
+	float frequency = 0.f;
+	float amplitude[ADDITIVE_BATCH] = {};
+
+	static float sine(float x) {
+		static std::vector<float> table = []() {
+			std::vector<float> t(1025);
+			for (int i = 0; i <= 1024; i++)
+				t[i] = std::sin(2.0 * M_PI * i / 1024);
+			return t;
+		}();
+		x -= std::floor(x);
+		float index = x * 1024.f;
+		int i = (int) index;
+		return table[i] + (table[i + 1] - table[i]) * (index - i);
+	}
+
+	void render(int first, float f, const float* amplitudes, float* out, int size) {
+		f = std::min(f, 0.5f);
+		float step = 1.f / size;
+		float value[ADDITIVE_BATCH];
+		float increment[ADDITIVE_BATCH];
+		for (int i = 0; i < ADDITIVE_BATCH; i++) {
+			float fi = std::min(f * (first + i), 0.5f);
+			float target = amplitudes[i] * (1.f - fi * 2.f);
+			value[i] = amplitude[i];
+			increment[i] = (target - amplitude[i]) * step;
+			amplitude[i] = target;
+		}
+		float fValue = frequency;
+		float fIncrement = (f - frequency) * step;
+		frequency = f;
+
+		for (int n = 0; n < size; n++) {
+			fValue += fIncrement;
+			phase += fValue;
+			if (phase >= 1.f)
+				phase -= 1.f;
+			float twoX = 2.f * sine(phase + 0.25f);
+			float previous;
+			float current;
+			if (first == 1) {
+				previous = 1.f;
+				current = twoX * 0.5f;
+			}
+			else {
+				previous = sine(phase * (first - 1) + 0.25f);
+				current = sine(phase * first + 0.25f);
+			}
+			float sum = 0.f;
+			for (int i = 0; i < ADDITIVE_BATCH; i++) {
+				value[i] += increment[i];
+				sum += value[i] * current;
+				float temp = current;
+				current = twoX * current - previous;
+				previous = temp;
+			}
+			if (first == 1)
+				out[n] = sum;
+			else
+				out[n] += sum;
+		}
+	}
+};
+
+
+/** Three oscillators wired like Plaits' harmonic engine: partials 1 to 24 summed to OUT, and 12 more to AUX. */
+template <typename T>
+struct AdditiveVoice {
+	T oscillators[3];
+
+	template <typename Render>
+	void render(const float* amplitudes, float* out, float* aux, int size, Render render) {
+		render(oscillators[0], 1, amplitudes, out, size);
+		render(oscillators[1], 13, amplitudes + ADDITIVE_BATCH, out, size);
+		render(oscillators[2], 1, amplitudes + 2 * ADDITIVE_BATCH, aux, size);
+	}
+};
+
+
+/** Fills the 36 amplitudes of block `block` with a moving spectrum that sums to 1, like the engine's normalized ones. */
+static void additiveAmplitudes(int64_t block, float* amplitudes) {
+	float sum = 0.f;
+	for (int i = 0; i < 3 * ADDITIVE_BATCH; i++) {
+		int harmonic = i % (2 * ADDITIVE_BATCH);
+		amplitudes[i] = (0.5f + 0.5f * std::sin(0.003f * block + 0.7f * harmonic)) / (harmonic + 1);
+		sum += amplitudes[i];
+	}
+	for (int i = 0; i < 3 * ADDITIVE_BATCH; i++)
+		amplitudes[i] /= sum;
+}
+
+
+int additive(float duration, const std::string& csvPath) {
+	// Plaits renders at 48 kHz in blocks of 12 whatever the engine's rate
+	const float sampleRate = 48000.f;
+	const int blockSize = 12;
+
+	FILE* csv = NULL;
+	if (!csvPath.empty()) {
+		csv = std::fopen(csvPath.c_str(), "w");
+		if (!csv) {
+			std::fprintf(stderr, "Could not write %s\n", csvPath.c_str());
+			return 1;
+		}
+		std::fprintf(csv, "frequency,scalar_ns,simd_ns,speedup,scalar_error,simd_error,simd_vs_scalar\n");
+	}
+	DEFER({
+		if (csv)
+			std::fclose(csv);
+	});
+
+	int exitCode = 0;
+	std::printf("Harmonic engine oscillators, ns/sample for 36 partials, and worst error against the exact sum\n");
+	std::printf("%8s %10s %10s %8s %12s %12s %12s\n", "Freq", "Scalar", "float_4", "Speedup", "Scalar err", "float_4 err", "Difference");
+	for (float freq : additiveFrequencies) {
+		const float f = freq / sampleRate;
+		int64_t blocks = std::max<int64_t>((int64_t) (duration * sampleRate) / blockSize, 1);
+		auto renderScalar = [&](ScalarHarmonicOscillator& o, int first, const float* a, float* y, int size) {
+			o.render(first, f, a, y, size);
+		};
+		auto renderSimd = [&](plaits::HarmonicOscillator<ADDITIVE_BATCH>& o, int first, const float* a, float* y, int size) {
+			if (first == 1)
+				o.Render<1>(f, a, y, size);
+			else
+				o.Render<13>(f, a, y, size);
+		};
+
+		// Accuracy against a double precision sum of the same ramps, on the first second
+		AdditiveVoice<ScalarHarmonicOscillator> scalar;
+		AdditiveVoice<plaits::HarmonicOscillator<ADDITIVE_BATCH>> simd;
+		for (auto& o : simd.oscillators)
+			o.Init();
+		double scalarError = 0.0;
+		double simdError = 0.0;
+		double difference = 0.0;
+		float exactPhase = 0.f;
+		float exactFrequency = 0.f;
+		double exactAmplitude[3 * ADDITIVE_BATCH] = {};
+		int64_t checkBlocks = std::min<int64_t>(blocks, (int64_t) sampleRate / blockSize);
+		for (int64_t b = 0; b < checkBlocks; b++) {
+			float amplitudes[3 * ADDITIVE_BATCH];
+			additiveAmplitudes(b, amplitudes);
+			float out[2][blockSize];
+			float aux[2][blockSize];
+			scalar.render(amplitudes, out[0], aux[0], blockSize, renderScalar);
+			simd.render(amplitudes, out[1], aux[1], blockSize, renderSimd);
+
+			// Exact sum, following the same float phase as both oscillators
+			double targets[3 * ADDITIVE_BATCH];
+			double increments[3 * ADDITIVE_BATCH];
+			for (int i = 0; i < 3 * ADDITIVE_BATCH; i++) {
+				int harmonic = i % (2 * ADDITIVE_BATCH) + 1;
+				double fi = std::min(f * harmonic, 0.5f);
+				targets[i] = amplitudes[i] * (1.0 - fi * 2.0);
+				increments[i] = (targets[i] - exactAmplitude[i]) / blockSize;
+			}
+			float fIncrement = (f - exactFrequency) / blockSize;
+			float fValue = exactFrequency;
+			exactFrequency = f;
+			for (int n = 0; n < blockSize; n++) {
+				fValue += fIncrement;
+				exactPhase += fValue;
+				if (exactPhase >= 1.f)
+					exactPhase -= 1.f;
+				double sum[2] = {};
+				for (int i = 0; i < 3 * ADDITIVE_BATCH; i++) {
+					int harmonic = i % (2 * ADDITIVE_BATCH) + 1;
+					double a = exactAmplitude[i] + increments[i] * (n + 1);
+					sum[i / (2 * ADDITIVE_BATCH)] += a * std::cos(2.0 * M_PI * harmonic * exactPhase);
+				}
+				scalarError = std::max(scalarError, std::fabs(out[0][n] - sum[0]));
+				scalarError = std::max(scalarError, std::fabs(aux[0][n] - sum[1]));
+				simdError = std::max(simdError, std::fabs(out[1][n] - sum[0]));
+				simdError = std::max(simdError, std::fabs(aux[1][n] - sum[1]));
+				difference = std::max(difference, (double) std::fabs(out[1][n] - out[0][n]));
+				difference = std::max(difference, (double) std::fabs(aux[1][n] - aux[0][n]));
+			}
+			for (int i = 0; i < 3 * ADDITIVE_BATCH; i++)
+				exactAmplitude[i] = targets[i];
+		}
+
+		// Cost, with the amplitudes computed up front so only the oscillators are timed
+		std::vector<float> amplitudes(64 * 3 * ADDITIVE_BATCH);
+		for (int b = 0; b < 64; b++)
+			additiveAmplitudes(b, &amplitudes[b * 3 * ADDITIVE_BATCH]);
+		float out[blockSize];
+		float aux[blockSize];
+		float sink = 0.f;
+
+		clock_type::time_point start = clock_type::now();
+		for (int64_t b = 0; b < blocks; b++) {
+			scalar.render(&amplitudes[(b % 64) * 3 * ADDITIVE_BATCH], out, aux, blockSize, renderScalar);
+			sink += out[0] + aux[0];
+		}
+		double scalarNs = std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / (blocks * blockSize);
+
+		start = clock_type::now();
+		for (int64_t b = 0; b < blocks; b++) {
+			simd.render(&amplitudes[(b % 64) * 3 * ADDITIVE_BATCH], out, aux, blockSize, renderSimd);
+			sink += out[0] + aux[0];
+		}
+		double simdNs = std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / (blocks * blockSize);
+		// Keep the output alive so the loops aren't optimized away
+		if (sink == 1e30f)
+			std::printf(" ");
+
+		bool ok = simdError <= ADDITIVE_MAX_ERROR;
+		if (!ok)
+			exitCode = 1;
+		std::printf("%8.0f %10.1f %10.1f %7.2fx %12.2g %12.2g %12.2g%s\n", freq, scalarNs, simdNs, scalarNs / simdNs, scalarError, simdError, difference, ok ? "" : "  INACCURATE");
+		if (csv)
+			std::fprintf(csv, "%.0f,%.1f,%.1f,%.3f,%.3g,%.3g,%.3g\n", freq, scalarNs, simdNs, scalarNs / simdNs, scalarError, simdError, difference);
+	}
+	return exitCode;
+}
+
+
+/** Length of the wavetable aliasing analysis, in samples.
+The test frequencies are an odd number of cycles per analysis length, so harmonics fall on every k-th DFT bin and aliases fall between them.
+*/
+static constexpr int WAVETABLE_ANALYSIS = 4096;
+/** Cycles per analysis length, about 105 Hz, 880 Hz, 3.5 kHz and 7 kHz at 48 kHz */
+static const std::vector<int> wavetableCycles = {9, 75, 301, 601};
+static const std::vector<int> wavetableWaves = {0, 37, 90, 151};
+/** Largest allowed share of aliasing in the mip-mapped output */
+static constexpr double WAVETABLE_MAX_ALIASING = -60.0;
+
+
+/** Returns the share of the energy of `y` outside the bins that are multiples of `cycles`, in dB. */
+static double wavetableAliasing(const std::vector<float>& y, int cycles) {
+	const int n = y.size();
+	std::vector<double> cosine(n);
+	for (int i = 0; i < n; i++)
+		cosine[i] = std::cos(2.0 * M_PI * i / n);
+
+	double total = 0.0;
+	for (float x : y)
+		total += (double) x * x;
+
+	// Parseval, counting each bin below Nyquist twice for its mirror image
+	double harmonic = 0.0;
+	for (int bin = cycles; bin < n / 2; bin += cycles) {
+		double re = 0.0;
+		double im = 0.0;
+		for (int i = 0; i < n; i++) {
+			int j = (int) (((int64_t) bin * i) % n);
+			re += y[i] * cosine[j];
+			im += y[i] * cosine[(j + n / 4) % n];
+		}
+		harmonic += 2.0 * (re * re + im * im) / n;
+	}
+	return 10.0 * std::log10(std::max(total - harmonic, total * 1e-15) / total);
+}
+
+
+/** Returns the cost of reading a wave at a fixed level, in ns/sample. */
+static double wavetableCost(const MipMappedWavetable& table, int level, float frequency, float duration, float sampleRate) {
+	int64_t frames = std::max<int64_t>((int64_t) (duration * sampleRate), 1);
+	float phase = 0.f;
+	float out = 0.f;
+	clock_type::time_point start = clock_type::now();
+	for (int64_t i = 0; i < frames; i++) {
+		phase += frequency;
+		if (phase >= 1.f)
+			phase -= 1.f;
+		// Sweep through the waves like the model's X/Y/Z controls
+		int wave = (i >> 12) % table.numWaves;
+		out += table.read(wave, level, phase);
+	}
+	double ns = std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / frames;
+	// Keep the output alive so the loop isn't optimized away
+	if (out == 1e30f)
+		std::printf(" ");
+	return ns;
+}
+
+
+int wavetable(float duration, float sampleRate, const std::string& csvPath) {
+	FILE* csv = NULL;
+	if (!csvPath.empty()) {
+		csv = std::fopen(csvPath.c_str(), "w");
+		if (!csv) {
+			std::fprintf(stderr, "Could not write %s\n", csvPath.c_str());
+			return 1;
+		}
+		std::fprintf(csv, "frequency,level,samples,full_aliasing_db,mipmap_aliasing_db,full_ns,mipmap_ns\n");
+	}
+	DEFER({
+		if (csv)
+			std::fclose(csv);
+	});
+
+	clock_type::time_point start = clock_type::now();
+	const MipMappedWavetable& table = plaitsWavetable();
+	double buildMs = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+	std::printf("Built %d levels of %d Plaits waves in %.1f ms, %.0f kB\n\n", table.numLevels, table.numWaves, buildMs, table.data.size() * sizeof(float) / 1024.0);
+
+	int exitCode = 0;
+	std::printf("Aliasing in dB, worst of %d waves, and ns/sample\n", (int) wavetableWaves.size());
+	std::printf("%8s %6s %8s %10s %10s %10s %10s\n", "Freq", "Level", "Samples", "Full", "Mip-map", "Full ns", "Mip ns");
+	for (int cycles : wavetableCycles) {
+		float frequency = (float) cycles / WAVETABLE_ANALYSIS;
+		int level = table.level(frequency);
+
+		double full = -INFINITY;
+		double mipmap = -INFINITY;
+		for (int wave : wavetableWaves) {
+			std::vector<float> y[2];
+			for (int l : {0, 1}) {
+				y[l].resize(WAVETABLE_ANALYSIS);
+				for (int i = 0; i < WAVETABLE_ANALYSIS; i++) {
+					// Exact phase, so the output repeats over the analysis length
+					float phase = (float) (((int64_t) cycles * i) % WAVETABLE_ANALYSIS) / WAVETABLE_ANALYSIS;
+					y[l][i] = table.read(wave, l ? level : 0, phase);
+				}
+			}
+			full = std::max(full, wavetableAliasing(y[0], cycles));
+			mipmap = std::max(mipmap, wavetableAliasing(y[1], cycles));
+		}
+
+		double fullNs = wavetableCost(table, 0, frequency, duration, sampleRate);
+		double mipmapNs = wavetableCost(table, level, frequency, duration, sampleRate);
+
+		bool ok = mipmap <= WAVETABLE_MAX_ALIASING;
+		if (!ok)
+			exitCode = 1;
+		int samples = table.samples(level);
+		std::printf("%8.0f %6d %8d %10.1f %10.1f %10.1f %10.1f%s\n", frequency * sampleRate, level, samples, full, mipmap, fullNs, mipmapNs, ok ? "" : "  ALIASING");
+		if (csv)
+			std::fprintf(csv, "%.0f,%d,%d,%.1f,%.1f,%.2f,%.2f\n", frequency * sampleRate, level, samples, full, mipmap, fullNs, mipmapNs);
+	}
+	return exitCode;
+}
+
+
+/** Search windows, in samples, from short ones to wider than the firmware could afford, to show how the cost grows */
+static const std::vector<int> correlatorWindows = {256, 512, 1024, 2048, 4096};
+/** Share of the source bits flipped from the destination, so the planted match isn't a perfect one */
+static constexpr float CORRELATOR_NOISE = 0.2f;
+/** Clouds processes blocks of 32 samples at 32 kHz */
+static constexpr double CORRELATOR_BLOCK_US = 1000.0;
+/** EvaluateSomeCandidates() is called once per block, and ends a search within this many calls */
+static constexpr int CORRELATOR_CALLS = 16;
+
+
+/** The firmware's search: 32 bits at a time, counted with shifts and masks. */
+struct ScalarCorrelator {
+	const uint32_t* source;
+	const uint32_t* destination;
+	int32_t size;
+
+	int32_t search() {
+		uint32_t bestScore = 0;
+		int32_t bestMatch = 0;
+		uint32_t numWords = size >> 5;
+		for (int32_t candidate = 0; candidate < size; candidate++) {
+			uint32_t offsetBits = candidate & 0x1f;
+			const uint32_t* d = &destination[candidate >> 5];
+			uint32_t score = 0;
+			for (uint32_t i = 0; i < numWords; i++) {
+				uint32_t bits = d[i] << offsetBits;
+				// The firmware shifts by 32 - offsetBits unconditionally, which is undefined for 0
+				if (offsetBits)
+					bits |= d[i + 1] >> (32 - offsetBits);
+				uint32_t count = ~(source[i] ^ bits);
+				count = count - ((count >> 1) & 0x55555555);
+				count = (count & 0x33333333) + ((count >> 2) & 0x33333333);
+				count = (((count + (count >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+				score += count;
+			}
+			if (score > bestScore) {
+				bestMatch = candidate;
+				bestScore = score;
+			}
+		}
+		return bestMatch;
+	}
+};
+
+
+/** Runs `search` for about `duration` seconds and returns its mean time in microseconds. */
+template <typename Search>
+static double correlatorCost(Search search, float duration, int32_t& match) {
+	int64_t searches = 0;
+	clock_type::time_point start = clock_type::now();
+	double elapsed = 0.0;
+	while (searches == 0 || elapsed < duration) {
+		match = search();
+		searches++;
+		elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+	}
+	return elapsed * 1e6 / searches;
+}
+
+
+int correlator(float duration, const std::string& csvPath) {
+	FILE* csv = NULL;
+	if (!csvPath.empty()) {
+		csv = std::fopen(csvPath.c_str(), "w");
+		if (!csv) {
+			std::fprintf(stderr, "Could not write %s\n", csvPath.c_str());
+			return 1;
+		}
+		std::fprintf(csv, "window,firmware_us,popcount_us,speedup,firmware_block_share,popcount_block_share,planted,firmware_match,popcount_match\n");
+	}
+	DEFER({
+		if (csv)
+			std::fclose(csv);
+	});
+
+	int exitCode = 0;
+	std::printf("Clouds WSOLA splice search, us per search of the whole window, and its share of a 1 ms block when spread over %d blocks\n", CORRELATOR_CALLS);
+	std::printf("%8s %10s %10s %8s %9s %9s %8s %8s %8s\n", "Window", "Firmware", "Popcount", "Speedup", "FW block", "PC block", "Planted", "FW", "PC");
+	Prng prng;
+	prng.seed(89);
+	for (int window : correlatorWindows) {
+		// Sign bits of a noise destination twice the window long, and a source copied from it at a known offset, with some bits flipped
+		int words = window >> 5;
+		std::vector<uint32_t> destination(2 * words + 1);
+		for (uint32_t& word : destination)
+			word = prng.u32();
+		int32_t planted = (int32_t) (prng.uniform() * window);
+		std::vector<uint32_t> source(words, 0);
+		for (int i = 0; i < window; i++) {
+			int bit = planted + i;
+			uint32_t value = (destination[bit >> 5] >> (31 - (bit & 0x1f))) & 1;
+			if (prng.uniform() < CORRELATOR_NOISE)
+				value ^= 1;
+			source[i >> 5] |= value << (31 - (i & 0x1f));
+		}
+
+		ScalarCorrelator scalar = {source.data(), destination.data(), window};
+		int32_t scalarMatch = -1;
+		double scalarUs = correlatorCost([&]() {
+			return scalar.search();
+		}, duration / 2, scalarMatch);
+
+		clouds::Correlator popcount;
+		popcount.Init(source.data(), destination.data());
+		int32_t popcountMatch = -1;
+		double popcountUs = correlatorCost([&]() {
+			// An increment of 1 in 16.16 fixed point, so best_match() is the candidate itself
+			popcount.StartSearch(window, 0, 1 << 16);
+			// Calls past the end of the search return at once
+			for (int call = 0; call < CORRELATOR_CALLS; call++)
+				popcount.EvaluateSomeCandidates();
+			return popcount.best_match();
+		}, duration / 2, popcountMatch);
+
+		bool ok = (popcountMatch == scalarMatch) && (popcountMatch == planted);
+		if (!ok)
+			exitCode = 1;
+		std::printf("%8d %10.2f %10.2f %7.2fx %8.1f%% %8.1f%% %8d %8d %8d%s\n", window, scalarUs, popcountUs, scalarUs / popcountUs, 100.0 * scalarUs / CORRELATOR_CALLS / CORRELATOR_BLOCK_US, 100.0 * popcountUs / CORRELATOR_CALLS / CORRELATOR_BLOCK_US, planted, scalarMatch, popcountMatch, ok ? "" : "  MISMATCH");
+		if (csv)
+			std::fprintf(csv, "%d,%.3f,%.3f,%.3f,%.4f,%.4f,%d,%d,%d\n", window, scalarUs, popcountUs, scalarUs / popcountUs, scalarUs / CORRELATOR_CALLS / CORRELATOR_BLOCK_US, popcountUs / CORRELATOR_CALLS / CORRELATOR_BLOCK_US, planted, scalarMatch, popcountMatch);
+	}
+	return exitCode;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+
+#include "../../src/plugin.hpp"
+
+
+/** Renders each Plaits engine and Braids shape on its own and prints the cost of each.
+`target` is "plaits", "braids" or "all".
+If `csvPath` is not empty, the table is also written there as CSV so it can be compared across releases.
+Returns the process exit code.
+*/
+int bench(plugin::Plugin* p, const std::string& target, float duration, float sampleRate, const std::string& csvPath);
+
+
+/** Times every process() call of the block-based modules and prints the distribution of per-call durations.
+`target` is a module slug, or "blocks" for Plaits, Rings, Clouds, Warps and Elements.
+Polyphonic modules are run with 1, 4 and 16 channels, and modules with a "spreadRender" option are run with it off and on.
+Returns the process exit code.
+*/
+int latency(plugin::Plugin* p, const std::string& target, float duration, float sampleRate, const std::string& csvPath);
+
+
+/** Feeds a loud noise burst and then `duration` seconds of silence through Rings, Elements, Clouds, Ripples and Shelves.
+Checks that the cost per sample stays flat while their feedback state decays, which it doesn't if the state goes denormal.
+Returns 1 if any module's slowest stretch of silence costs more than twice its typical one.
+*/
+int denormal(plugin::Plugin* p, float duration, float sampleRate, const std::string& csvPath);
+
+
+/** Compares the RK2 and implicit solvers of the Ripples engine.
+Prints the cost of each at several cutoffs over `duration` seconds, and how far their LP4 response and self-oscillation pitch are from RK2 at 16 times the sample rate.
+Returns 1 if the implicit solver is further from it than the limits in bench.cpp.
+*/
+int ripplesSolvers(float duration, float sampleRate, const std::string& csvPath);
+
+
+/** Compares the float_4 harmonic oscillator that Plaits' harmonic engine is built with against the firmware's scalar Chebyshev recurrence.
+Prints the cost of each at several pitches over `duration` seconds, and their worst difference from an exact sum of the same partials.
+Returns 1 if the float_4 oscillator is further from it than the limit in bench.cpp.
+*/
+int additive(float duration, const std::string& csvPath);
+
+
+/** Reads Plaits' wavetables from the full-size tables and from their mip-mapped copies at several pitches.
+Prints the share of aliasing in each output, and the cost of each read over `duration` seconds.
+Returns 1 if the mip-mapped output has more aliasing than the limit in bench.cpp.
+*/
+int wavetable(float duration, float sampleRate, const std::string& csvPath);
+
+
+/** Times the splice search of Clouds' WSOLA player against a copy of the firmware's, on windows of several sizes with a known best match.
+Prints the time of a whole search with each, and its share of a block.
+Returns 1 if either search misses the match, or if they disagree.
+*/
+int correlator(float duration, const std::string& csvPath);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#if defined(ARCH_LIN)
+	#include <linux/perf_event.h>
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif
+
+
+/** Counts a hardware event on the calling thread.
+Only available on Linux, and only where perf_event_paranoid allows it. Otherwise ok() returns false and stop() returns 0.
+*/
+struct PerfCounter {
+	int fd = -1;
+
+	PerfCounter(uint32_t type, uint64_t config) {
+#if defined(ARCH_LIN)
+		perf_event_attr attr = {};
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	}
+
+	~PerfCounter() {
+#if defined(ARCH_LIN)
+		if (fd >= 0)
+			close(fd);
+#endif
+	}
+
+	PerfCounter(const PerfCounter&) = delete;
+	PerfCounter& operator=(const PerfCounter&) = delete;
+
+	bool ok() {
+		return fd >= 0;
+	}
+
+	void start() {
+#if defined(ARCH_LIN)
+		if (fd < 0)
+			return;
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+	}
+
+	int64_t stop() {
+		int64_t count = 0;
+#if defined(ARCH_LIN)
+		if (fd < 0)
+			return 0;
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(fd, &count, sizeof(count)) != sizeof(count))
+			count = 0;
+#endif
+		return count;
+	}
+};
+
+
+/** Last-level cache and data TLB misses */
+struct CacheCounters {
+#if defined(ARCH_LIN)
+	PerfCounter cacheMisses {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES};
+	PerfCounter tlbMisses {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+#else
+	PerfCounter cacheMisses {0, 0};
+	PerfCounter tlbMisses {0, 0};
+#endif
+};
@@ -0,0 +1,514 @@
+// Headless offline renderer for patches built from Audible Instruments modules.
+//
+// Loads a patch in Rack's JSON patch format (a v1 .vcv file, or the patch.json inside a v2 .vcv archive),
+// instantiates the modules without a window or audio device, and renders them to a 32-bit float WAV file as fast as the CPU allows.
+// Modules from other plugins are skipped along with their cables.
+//
+// Cables are stepped before modules on every frame, so each cable has the same one-sample delay as in Rack's engine.
+// Modules that aren't connected to each other form independent chains, which are rendered in parallel.
+//
+// With --bench, renders each Plaits engine and Braids shape on its own instead of a patch, and prints a table of their costs (see bench.cpp).
+// With --latency, prints the distribution of per-sample process() times of the block-based modules instead.
+// With --bench denormal, checks that silence after a loud burst costs the same throughout.
+// With --bench ripples, compares the cost and accuracy of the Ripples filter solvers.
+// With --bench additive, compares Plaits' float_4 harmonic oscillator with the firmware's scalar one.
+// With --bench wavetable, measures the aliasing of Plaits' wavetables read from full-size and mip-mapped tables.
+// With --bench correlator, times the splice search of Clouds' WSOLA player against the firmware's.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../src/plugin.hpp"
+#include "wav.hpp"
+#include "perf.hpp"
+#include "bench.hpp"
+
+
+using clock_type = std::chrono::steady_clock;
+
+
+struct PatchModule {
+	int64_t id;
+	engine::Module* module;
+	/** Time spent in process(), in seconds */
+	double time = 0.0;
+};
+
+
+struct PatchCable {
+	engine::Module* outputModule;
+	int outputId;
+	engine::Module* inputModule;
+	int inputId;
+};
+
+
+/** An output port recorded into one channel of the WAV file */
+struct Tap {
+	int64_t moduleId;
+	int outputId;
+	int channel = 0;
+	engine::Module* module = NULL;
+	std::vector<float> samples;
+};
+
+
+/** A set of modules connected by cables, rendered on a single thread */
+struct Chain {
+	std::vector<PatchModule*> modules;
+	std::vector<PatchCable> cables;
+	std::vector<Tap*> taps;
+	double wallTime = 0.0;
+	/** Hardware counters over the whole render, or -1 if unavailable */
+	int64_t cacheMisses = -1;
+	int64_t tlbMisses = -1;
+};
+
+
+struct Patch {
+	std::vector<PatchModule> modules;
+	std::vector<PatchCable> cables;
+
+	~Patch() {
+		for (PatchModule& pm : modules)
+			delete pm.module;
+	}
+
+	PatchModule* getModule(int64_t id) {
+		for (PatchModule& pm : modules) {
+			if (pm.id == id)
+				return &pm;
+		}
+		return NULL;
+	}
+};
+
+
+static plugin::Model* findModel(plugin::Plugin* p, const std::string& slug) {
+	for (plugin::Model* model : p->models) {
+		if (model->slug == slug)
+			return model;
+	}
+	return NULL;
+}
+
+
+static bool loadPatch(Patch& patch, plugin::Plugin* p, const std::string& path) {
+	json_error_t error;
+	json_t* rootJ = json_load_file(path.c_str(), 0, &error);
+	if (!rootJ) {
+		std::fprintf(stderr, "Could not parse %s: %s at line %d\n", path.c_str(), error.text, error.line);
+		return false;
+	}
+	DEFER({json_decref(rootJ);});
+
+	json_t* modulesJ = json_object_get(rootJ, "modules");
+	if (!json_is_array(modulesJ)) {
+		std::fprintf(stderr, "%s has no modules\n", path.c_str());
+		return false;
+	}
+
+	// Reserve up front so PatchModule pointers stay valid
+	patch.modules.reserve(json_array_size(modulesJ));
+
+	size_t i;
+	json_t* moduleJ;
+	json_array_foreach(modulesJ, i, moduleJ) {
+		json_t* idJ = json_object_get(moduleJ, "id");
+		json_t* pluginJ = json_object_get(moduleJ, "plugin");
+		json_t* modelJ = json_object_get(moduleJ, "model");
+		int64_t id = idJ ? json_integer_value(idJ) : (int64_t) i;
+		std::string pluginSlug = pluginJ ? json_string_value(pluginJ) : p->slug;
+		std::string modelSlug = modelJ ? json_string_value(modelJ) : "";
+
+		if (pluginSlug != p->slug) {
+			std::fprintf(stderr, "Skipping module %" PRId64 " (%s %s)\n", id, pluginSlug.c_str(), modelSlug.c_str());
+			continue;
+		}
+		plugin::Model* model = findModel(p, modelSlug);
+		if (!model) {
+			std::fprintf(stderr, "Unknown model %s\n", modelSlug.c_str());
+			return false;
+		}
+
+		engine::Module* module = model->createModule();
+		engine::Module::AddEvent eAdd;
+		module->onAdd(eAdd);
+		// Loads params and module data with the same code Rack uses
+		module->fromJson(moduleJ);
+
+		PatchModule pm;
+		pm.id = id;
+		pm.module = module;
+		patch.modules.push_back(pm);
+	}
+
+	json_t* cablesJ = json_object_get(rootJ, "cables");
+	// Rack v1 patches call them wires
+	if (!cablesJ)
+		cablesJ = json_object_get(rootJ, "wires");
+	json_t* cableJ;
+	json_array_foreach(cablesJ, i, cableJ) {
+		int64_t outputModuleId = json_integer_value(json_object_get(cableJ, "outputModuleId"));
+		int64_t inputModuleId = json_integer_value(json_object_get(cableJ, "inputModuleId"));
+		PatchModule* outputModule = patch.getModule(outputModuleId);
+		PatchModule* inputModule = patch.getModule(inputModuleId);
+		if (!outputModule || !inputModule)
+			continue;
+
+		PatchCable cable;
+		cable.outputModule = outputModule->module;
+		cable.outputId = json_integer_value(json_object_get(cableJ, "outputId"));
+		cable.inputModule = inputModule->module;
+		cable.inputId = json_integer_value(json_object_get(cableJ, "inputId"));
+		if (cable.outputId < 0 || cable.outputId >= (int) cable.outputModule->outputs.size())
+			continue;
+		if (cable.inputId < 0 || cable.inputId >= (int) cable.inputModule->inputs.size())
+			continue;
+
+		// Mark both ports as connected, as Engine::addCable() does
+		cable.outputModule->outputs[cable.outputId].channels = std::max<int>(cable.outputModule->outputs[cable.outputId].channels, 1);
+		cable.inputModule->inputs[cable.inputId].channels = 1;
+		patch.cables.push_back(cable);
+	}
+	return true;
+}
+
+
+/** Groups modules into chains connected by cables, keeping only chains that feed a tap. */
+static std::vector<Chain> buildChains(Patch& patch, std::vector<Tap>& taps) {
+	size_t n = patch.modules.size();
+	std::vector<size_t> parent(n);
+	for (size_t i = 0; i < n; i++)
+		parent[i] = i;
+	auto find = [&](size_t i) {
+		while (parent[i] != i)
+			i = parent[i] = parent[parent[i]];
+		return i;
+	};
+	auto indexOf = [&](engine::Module* module) {
+		for (size_t i = 0; i < n; i++) {
+			if (patch.modules[i].module == module)
+				return i;
+		}
+		return n;
+	};
+
+	for (PatchCable& cable : patch.cables)
+		parent[find(indexOf(cable.outputModule))] = find(indexOf(cable.inputModule));
+
+	std::map<size_t, Chain> chains;
+	for (Tap& tap : taps)
+		chains[find(indexOf(tap.module))].taps.push_back(&tap);
+	for (size_t i = 0; i < n; i++) {
+		auto it = chains.find(find(i));
+		if (it != chains.end())
+			it->second.modules.push_back(&patch.modules[i]);
+	}
+	for (PatchCable& cable : patch.cables) {
+		auto it = chains.find(find(indexOf(cable.outputModule)));
+		if (it != chains.end())
+			it->second.cables.push_back(cable);
+	}
+
+	std::vector<Chain> result;
+	for (auto& it : chains)
+		result.push_back(it.second);
+	return result;
+}
+
+
+static void stepCable(const PatchCable& cable) {
+	engine::Output& output = cable.outputModule->outputs[cable.outputId];
+	engine::Input& input = cable.inputModule->inputs[cable.inputId];
+	int channels = output.channels;
+	for (int c = 0; c < channels; c++) {
+		float v = output.voltages[c];
+		// Set 0V if infinite or NaN
+		if (!std::isfinite(v))
+			v = 0.f;
+		input.voltages[c] = v;
+	}
+	for (int c = channels; c < input.channels; c++)
+		input.voltages[c] = 0.f;
+	input.channels = channels;
+}
+
+
+static void renderChain(Chain& chain, float sampleRate, int64_t frames) {
+	CacheCounters counters;
+	counters.cacheMisses.start();
+	counters.tlbMisses.start();
+	clock_type::time_point chainStart = clock_type::now();
+
+	engine::Module::ProcessArgs args;
+	args.sampleRate = sampleRate;
+	args.sampleTime = 1.f / sampleRate;
+
+	for (Tap* tap : chain.taps)
+		tap->samples.resize(frames);
+
+	for (args.frame = 0; args.frame < frames; args.frame++) {
+		for (const PatchCable& cable : chain.cables)
+			stepCable(cable);
+
+		for (PatchModule* pm : chain.modules) {
+			clock_type::time_point start = clock_type::now();
+			pm->module->process(args);
+			pm->time += std::chrono::duration<double>(clock_type::now() - start).count();
+		}
+
+		// Scale like Rack's Audio module and the plugin's recorder, where ±10 V is full scale
+		for (Tap* tap : chain.taps)
+			tap->samples[args.frame] = tap->module->outputs[tap->outputId].voltages[tap->channel] / 10.f;
+	}
+
+	chain.wallTime = std::chrono::duration<double>(clock_type::now() - chainStart).count();
+	int64_t cacheMisses = counters.cacheMisses.stop();
+	int64_t tlbMisses = counters.tlbMisses.stop();
+	if (counters.cacheMisses.ok())
+		chain.cacheMisses = cacheMisses;
+	if (counters.tlbMisses.ok())
+		chain.tlbMisses = tlbMisses;
+}
+
+
+static int render(Context* context, plugin::Plugin* p, const std::string& patchPath, std::vector<Tap>& taps, const std::string& outputPath, float duration, float sampleRate, int threadCount) {
+	Patch patch;
+	if (!loadPatch(patch, p, patchPath))
+		return 1;
+
+	for (Tap& tap : taps) {
+		PatchModule* pm = patch.getModule(tap.moduleId);
+		if (!pm || tap.outputId < 0 || tap.outputId >= (int) pm->module->outputs.size() || tap.channel < 0 || tap.channel >= PORT_MAX_CHANNELS) {
+			std::fprintf(stderr, "No output %d on module %" PRId64 "\n", tap.outputId, tap.moduleId);
+			return 1;
+		}
+		tap.module = pm->module;
+		// Modules skip work for outputs that aren't connected
+		engine::Output& output = tap.module->outputs[tap.outputId];
+		output.channels = std::max<int>(output.channels, 1);
+	}
+
+	std::vector<Chain> chains = buildChains(patch, taps);
+	int64_t frames = (int64_t) std::ceil(duration * sampleRate);
+
+	// Render chains in parallel
+	clock_type::time_point start = clock_type::now();
+	std::atomic<size_t> nextChain(0);
+	auto worker = [&]() {
+		// Rack's context and random state are thread-local
+		contextSet(context);
+		random::init();
+		DenormalGuard denormalGuard;
+		size_t i;
+		while ((i = nextChain++) < chains.size())
+			renderChain(chains[i], sampleRate, frames);
+	};
+	std::vector<std::thread> threads;
+	for (int t = 0; t < std::min<int>(threadCount, chains.size()); t++)
+		threads.emplace_back(worker);
+	for (std::thread& thread : threads)
+		thread.join();
+	double wallTime = std::chrono::duration<double>(clock_type::now() - start).count();
+
+	// Interleave taps and write the WAV file
+	std::vector<float> samples(frames * taps.size());
+	for (int64_t f = 0; f < frames; f++) {
+		for (size_t t = 0; t < taps.size(); t++)
+			samples[f * taps.size() + t] = taps[t].samples[f];
+	}
+	if (!writeWav(outputPath, samples, taps.size(), (int) sampleRate)) {
+		std::fprintf(stderr, "Could not write %s\n", outputPath.c_str());
+		return 1;
+	}
+
+	// Report timing
+	double renderedTime = frames / sampleRate;
+	std::printf("Rendered %.3f s in %.3f s (%.1fx realtime) on %d threads\n", renderedTime, wallTime, renderedTime / wallTime, (int) threads.size());
+	std::printf("\n%-8s %-12s %10s %12s %8s\n", "Id", "Module", "Time (ms)", "ns/sample", "% DSP");
+	for (size_t c = 0; c < chains.size(); c++) {
+		for (PatchModule* pm : chains[c].modules) {
+			std::printf("%-8" PRId64 " %-12s %10.1f %12.1f %8.2f\n",
+				pm->id,
+				pm->module->model->slug.c_str(),
+				pm->time * 1e3,
+				pm->time / frames * 1e9,
+				pm->time / renderedTime * 100.0);
+		}
+		std::printf("Chain %zu: %.3f s\n", c, chains[c].wallTime);
+		if (chains[c].cacheMisses >= 0)
+			std::printf("Cache misses: %.3f per sample\n", (double) chains[c].cacheMisses / frames);
+		if (chains[c].tlbMisses >= 0)
+			std::printf("dTLB misses: %.3f per sample\n", (double) chains[c].tlbMisses / frames);
+		std::printf("\n");
+	}
+	return 0;
+}
+
+
+static void printUsage(const char* name) {
+	std::fprintf(stderr,
+		"Usage: %s [options] <patch.json>\n"
+		"       %s --bench plaits|braids|all|denormal|ripples|additive|wavetable|correlator [-d SECONDS] [-r RATE] [--csv FILE]\n"
+		"       %s --latency blocks|MODEL [-d SECONDS] [-r RATE] [--csv FILE]\n"
+		"\n"
+		"Options:\n"
+		"  -o FILE         Output WAV file (default out.wav)\n"
+		"  -t ID:OUTPUT[:CHANNEL]\n"
+		"                  Record an output port of a module into the next WAV channel.\n"
+		"                  Can be given multiple times.\n"
+		"  -d SECONDS      Duration to render (default 10)\n"
+		"  -r RATE         Sample rate in Hz (default 48000)\n"
+		"  -j THREADS      Number of threads for independent chains (default: number of cores)\n"
+		"  --bench TARGET  Time each Plaits engine and/or Braids shape in isolation.\n"
+		"                  -d is the duration of each case (default 2).\n"
+		"                  \"denormal\" instead feeds a burst and then -d seconds of silence\n"
+		"                  (default 10) through the modules with feedback state, and fails\n"
+		"                  if the cost per sample rises during the silence.\n"
+		"                  \"ripples\" instead compares the cost, response and self-oscillation\n"
+		"                  pitch of the Ripples filter solvers.\n"
+		"                  \"additive\" instead compares the cost and accuracy of Plaits'\n"
+		"                  float_4 harmonic oscillator with the firmware's scalar one.\n"
+		"                  \"wavetable\" instead measures the aliasing and cost of Plaits'\n"
+		"                  wavetables read from full-size and mip-mapped tables.\n"
+		"                  \"correlator\" instead times the splice search of Clouds' WSOLA\n"
+		"                  player against the firmware's, for several window sizes.\n"
+		"  --latency TARGET\n"
+		"                  Time every process() call of Plaits, Rings, Clouds, Warps and Elements,\n"
+		"                  or of one of them, and print p50/p99/p99.9/max per channel count.\n"
+		"                  -d is the duration of each case (default 2).\n"
+		"  --csv FILE      Also write the benchmark table to a CSV file\n",
+		name, name, name);
+}
+
+
+int main(int argc, char* argv[]) {
+	std::string outputPath = "out.wav";
+	std::string patchPath;
+	std::vector<Tap> taps;
+	float duration = 0.f;
+	std::string benchTarget;
+	std::string latencyTarget;
+	std::string csvPath;
+	float sampleRate = 48000.f;
+	int threadCount = std::max<int>(std::thread::hardware_concurrency(), 1);
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = (i + 1 < argc);
+		if (arg == "-o" && hasValue) {
+			outputPath = argv[++i];
+		}
+		else if (arg == "-t" && hasValue) {
+			Tap tap;
+			long long moduleId;
+			if (std::sscanf(argv[++i], "%lld:%d:%d", &moduleId, &tap.outputId, &tap.channel) < 2) {
+				printUsage(argv[0]);
+				return 1;
+			}
+			tap.moduleId = moduleId;
+			taps.push_back(tap);
+		}
+		else if (arg == "-d" && hasValue) {
+			duration = std::atof(argv[++i]);
+		}
+		else if (arg == "-r" && hasValue) {
+			sampleRate = std::atof(argv[++i]);
+		}
+		else if (arg == "-j" && hasValue) {
+			threadCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "--bench" && hasValue) {
+			benchTarget = argv[++i];
+		}
+		else if (arg == "--latency" && hasValue) {
+			latencyTarget = argv[++i];
+		}
+		else if (arg == "--csv" && hasValue) {
+			csvPath = argv[++i];
+		}
+		else if (arg[0] != '-' && patchPath.empty()) {
+			patchPath = arg;
+		}
+		else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+	bool benchmark = !benchTarget.empty() || !latencyTarget.empty();
+	if (duration == 0.f)
+		duration = (benchmark && benchTarget != "denormal") ? 2.f : 10.f;
+	bool valid = benchmark ? (patchPath.empty() && (benchTarget.empty() || latencyTarget.empty())) : (!patchPath.empty() && !taps.empty());
+	if (!valid || sampleRate <= 0.f || duration <= 0.f) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	// Initialize Rack without a window or audio device.
+	// Dev mode keeps Rack from touching the user's Rack directory and sends the log to stderr.
+	settings::devMode = true;
+	settings::headless = true;
+	asset::init();
+	logger::init();
+	random::init();
+
+	Context* context = new Context;
+	contextSet(context);
+	context->engine = new engine::Engine;
+	context->engine->setSampleRate(sampleRate);
+
+	plugin::Plugin* p = new plugin::Plugin;
+	p->slug = "AudibleInstruments";
+	p->path = asset::systemDir;
+	::init(p);
+
+	int exitCode;
+	if (benchTarget == "denormal") {
+		// Without a guard of its own, so the modules' guards are what is tested
+		exitCode = denormal(p, duration, sampleRate, csvPath);
+	}
+	else if (benchTarget == "ripples") {
+		DenormalGuard denormalGuard;
+		exitCode = ripplesSolvers(duration, sampleRate, csvPath);
+	}
+	else if (benchTarget == "additive") {
+		DenormalGuard denormalGuard;
+		exitCode = additive(duration, csvPath);
+	}
+	else if (benchTarget == "wavetable") {
+		DenormalGuard denormalGuard;
+		exitCode = wavetable(duration, sampleRate, csvPath);
+	}
+	else if (benchTarget == "correlator") {
+		DenormalGuard denormalGuard;
+		exitCode = correlator(duration, csvPath);
+	}
+	else if (!benchTarget.empty()) {
+		DenormalGuard denormalGuard;
+		exitCode = bench(p, benchTarget, duration, sampleRate, csvPath);
+	}
+	else if (!latencyTarget.empty()) {
+		DenormalGuard denormalGuard;
+		exitCode = latency(p, latencyTarget, duration, sampleRate, csvPath);
+	}
+	else {
+		exitCode = render(context, p, patchPath, taps, outputPath, duration, sampleRate, threadCount);
+	}
+
+	delete p;
+	contextSet(NULL);
+	delete context;
+	logger::destroy();
+	return exitCode;
+}
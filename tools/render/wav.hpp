@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../../src/plugin.hpp"
+
+
+/** Writes interleaved 32-bit float samples to a WAV file.
+Uses the plugin's recorder header, so renders too large for RIFF are written as RF64.
+Returns false if the file could not be written.
+*/
+inline bool writeWav(const std::string& path, const std::vector<float>& samples, int channels, int sampleRate) {
+	FILE* f = std::fopen(path.c_str(), "wb");
+	if (!f)
+		return false;
+
+	uint64_t dataSize = (uint64_t) samples.size() * sizeof(float);
+	writeWavHeader(f, channels, sampleRate, dataSize);
+	// Samples are written in host byte order, which is little-endian on every platform Rack supports.
+	size_t written = std::fwrite(samples.data(), sizeof(float), samples.size(), f);
+
+	bool ok = (written == samples.size()) && !std::ferror(f);
+	ok = (std::fclose(f) == 0) && ok;
+	return ok;
+}
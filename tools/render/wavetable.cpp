@@ -0,0 +1,99 @@
+#include "wavetable.hpp"
+#include "plaits/resources.h"
+
+
+/** Plaits' wavetable model reads 192 waves of 128 samples, each stored integrated and followed by 4 guard samples */
+static const int PLAITS_NUM_WAVES = 192;
+static const int PLAITS_WAVE_SIZE = 128;
+static const int PLAITS_WAVE_STRIDE = PLAITS_WAVE_SIZE + 4;
+
+
+void MipMappedWavetable::build(const int16_t* waves, int numWaves, int size, int stride, bool integrated) {
+	assert(size >= 4 && (size & (size - 1)) == 0);
+	this->numWaves = numWaves;
+	this->size = size;
+	numLevels = 0;
+	levelOffsets.clear();
+	size_t total = 0;
+	for (int l = 0; harmonics(l) >= 1; l++) {
+		levelOffsets.push_back(total);
+		total += (size_t) numWaves * (samples(l) + GUARD);
+		numLevels++;
+	}
+	data.assign(total, 0.f);
+
+	// cos(2 pi k / n) at the resolution of level 0, so every sample of every level is a lookup
+	int n0 = samples(0);
+	std::vector<double> cosine(n0);
+	for (int k = 0; k < n0; k++)
+		cosine[k] = std::cos(2.0 * M_PI * k / n0);
+	auto sine = [&](int64_t i) {
+		return cosine[(i + n0 - n0 / 4) % n0];
+	};
+
+	int maxHarmonic = harmonics(0);
+	std::vector<double> re(maxHarmonic + 1);
+	std::vector<double> im(maxHarmonic + 1);
+	std::vector<double> x(n0);
+
+	for (int w = 0; w < numWaves; w++) {
+		const int16_t* wave = &waves[(size_t) w * stride];
+
+		// Spectrum, without DC
+		for (int h = 1; h <= maxHarmonic; h++) {
+			double a = 0.0;
+			double b = 0.0;
+			for (int k = 0; k < size; k++) {
+				int64_t i = ((int64_t) h * k * (n0 / size)) % n0;
+				a += wave[k] * cosine[i];
+				b += wave[k] * sine(i);
+			}
+			re[h] = a * 2.0 / size;
+			im[h] = b * 2.0 / size;
+			if (integrated) {
+				// d/dt (a cos + b sin) = h (b cos - a sin), up to a constant the peak normalization removes
+				double ra = re[h];
+				re[h] = h * im[h];
+				im[h] = -h * ra;
+			}
+		}
+
+		double gain = 1.0;
+		for (int l = 0; l < numLevels; l++) {
+			int n = samples(l);
+			for (int k = 0; k < n; k++) {
+				x[k] = 0.0;
+				for (int h = 1; h <= harmonics(l); h++) {
+					int64_t i = ((int64_t) h * k * (n0 / n)) % n0;
+					x[k] += re[h] * cosine[i] + im[h] * sine(i);
+				}
+			}
+
+			if (l == 0) {
+				double peak = 0.0;
+				for (int k = 0; k < n; k++)
+					peak = std::max(peak, std::fabs(x[k]));
+				if (peak > 0.0)
+					gain = 1.0 / peak;
+			}
+
+			float* t = &data[levelOffsets[l] + (size_t) w * (n + GUARD)];
+			t[0] = x[n - 1] * gain;
+			for (int k = 0; k < n; k++)
+				t[1 + k] = x[k] * gain;
+			t[n + 1] = x[0] * gain;
+			t[n + 2] = x[1] * gain;
+		}
+	}
+}
+
+
+const MipMappedWavetable& plaitsWavetable() {
+	// Function-local statics are initialized once, even with concurrent first calls
+	static const MipMappedWavetable table = []() {
+		MipMappedWavetable t;
+		t.build(plaits::wav_integrated_waves, PLAITS_NUM_WAVES, PLAITS_WAVE_SIZE, PLAITS_WAVE_STRIDE, true);
+		return t;
+	}();
+	return table;
+}
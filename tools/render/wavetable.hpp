@@ -0,0 +1,79 @@
+#pragma once
+
+#include <rack.hpp>
+#include <cstdint>
+#include <vector>
+
+
+/** Band-limited copies of a set of single-cycle waves, one per octave.
+
+Level 0 holds every harmonic the source waves have. Each level above it holds half as many harmonics in half as many samples, down to a sine.
+level() picks the level whose highest harmonic stays below Nyquist at a given frequency, so high notes don't alias and read the smallest tables.
+Every level has OVERSAMPLING samples per cycle of its highest harmonic, which keeps the interpolation error from aliasing audibly.
+Built once and read-only afterwards, so any number of instances can share one.
+*/
+struct MipMappedWavetable {
+	static constexpr int OVERSAMPLING = 8;
+	/** Samples stored around each wave for interpolation: one before it and two after it */
+	static constexpr int GUARD = 3;
+
+	int numWaves = 0;
+	/** Samples per wave of the source waves, a power of 2 */
+	int size = 0;
+	int numLevels = 0;
+	/** Waves of every level, level after level, each with its guard samples */
+	std::vector<float> data;
+	/** Index of each level's first wave in `data` */
+	std::vector<size_t> levelOffsets;
+
+	/** Builds the levels from `numWaves` waves of `size` samples, `stride` samples apart in `waves`.
+	The Nyquist bin of the source waves is dropped, since its phase is unknown.
+	If `integrated`, the waves are stored as their integral, like Plaits' are, and are differentiated first.
+	Each wave is scaled to a peak of 1 at level 0, and keeps that gain at every level.
+	*/
+	void build(const int16_t* waves, int numWaves, int size, int stride, bool integrated);
+
+	/** Returns the highest harmonic stored in a level. */
+	int harmonics(int level) const {
+		return (size / 2 >> level) - 1;
+	}
+
+	/** Returns the number of samples per wave in a level. */
+	int samples(int level) const {
+		return OVERSAMPLING * (size / 2 >> level);
+	}
+
+	/** Returns the lowest level with no harmonic at or above Nyquist at `frequency`, in cycles per sample. */
+	int level(float frequency) const {
+		int l = 0;
+		while (l < numLevels - 1 && harmonics(l) * frequency >= 0.5f)
+			l++;
+		return l;
+	}
+
+	/** Reads a wave at `phase` in [0, 1), with 4-point Hermite interpolation. */
+	float read(int wave, int level, float phase) const {
+		int n = samples(level);
+		const float* t = &data[levelOffsets[level] + (size_t) wave * (n + GUARD)];
+		float p = phase * n;
+		int i = (int) p;
+		float f = p - i;
+		// Same interpolator as stmlib's InterpolateHermite()
+		float xm1 = t[i];
+		float x0 = t[i + 1];
+		float x1 = t[i + 2];
+		float x2 = t[i + 3];
+		float c = (x1 - xm1) * 0.5f;
+		float v = x0 - x1;
+		float w = c + v;
+		float a = w + v + (x2 - x0) * 0.5f;
+		float bNeg = w + a;
+		return (((a * f) - bNeg) * f + c) * f + x0;
+	}
+};
+
+
+/** Returns the mip-mapped copy of the wavetables of Plaits' wavetable model.
+Built from the firmware's resource arrays by the first call, which may come from any thread.
+*/
+const MipMappedWavetable& plaitsWavetable();